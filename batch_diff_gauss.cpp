@@ -0,0 +1,148 @@
+#include "batch_diff_gauss.hpp"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <pthread.h>
+#include <sched.h>
+
+// Waits on a full or empty queue: yields first, then sleeps so an idle
+// stage does not take a core from the busy ones
+static void backoff(int& spins) {
+    if (++spins < 64) {
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
+template <typename T>
+static void pushWait(BoundedQueue<T>& queue, T& value) {
+    int spins = 0;
+    while (!queue.tryPush(value)) backoff(spins);
+}
+
+// Next element, or false once the queue is empty and its producers are done
+template <typename T>
+static bool popWait(BoundedQueue<T>& queue, const std::atomic<int>& producersLeft, T& value) {
+    int spins = 0;
+    for (;;) {
+        if (queue.tryPop(value)) return true;
+        // Producers finish their pushes before signing off, so one more look settles it
+        if (producersLeft.load(std::memory_order_acquire) == 0) return queue.tryPop(value);
+        backoff(spins);
+    }
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Per-thread counters, summed into the stage totals after the join
+struct ThreadTally {
+    int images = 0;
+    int failed = 0;
+    double busySeconds = 0.0;
+    double megapixels = 0.0;
+};
+
+BatchPipelineStats runBatchPipeline(const std::vector<std::string>& inputs, const std::string& outputPath,
+                                    const std::function<FileManager(const FileManager&, int)>& process,
+                                    const BatchPipelineConfig& config) {
+    int decoders = std::max(config.decoders, 1);
+    int computeWorkers = std::max(config.computeWorkers, 1);
+    int encoders = std::max(config.encoders, 1);
+    size_t depth = std::max(config.queueDepth, 1);
+
+    BoundedQueue<FileManager> decoded(depth);
+    BoundedQueue<FileManager> processed(depth);
+    std::atomic<size_t> nextInput{0};
+    std::atomic<int> decodersLeft{decoders};
+    std::atomic<int> computeLeft{computeWorkers};
+    std::vector<ThreadTally> decodeTally(decoders);
+    std::vector<ThreadTally> computeTally(computeWorkers);
+    std::vector<ThreadTally> encodeTally(encoders);
+
+    auto decodeLoop = [&](int d) {
+        ThreadTally& tally = decodeTally[d];
+        size_t i;
+        while ((i = nextInput.fetch_add(1, std::memory_order_relaxed)) < inputs.size()) {
+            auto start = std::chrono::steady_clock::now();
+            FileManager image(inputs[i], "image");
+            tally.busySeconds += secondsSince(start);
+            if (!image.isValid()) {
+                ++tally.failed;
+                continue;
+            }
+            pushWait(decoded, image);
+            ++tally.images;
+        }
+        decodersLeft.fetch_sub(1, std::memory_order_release);
+    };
+
+    auto computeLoop = [&](int w) {
+        ThreadTally& tally = computeTally[w];
+        FileManager image;
+        while (popWait(decoded, decodersLeft, image)) {
+            auto start = std::chrono::steady_clock::now();
+            FileManager result = process(image, w);
+            tally.busySeconds += secondsSince(start);
+            image = FileManager(); // Free the decoded pixels before waiting for the next image
+            if (!result.isValid()) {
+                ++tally.failed;
+                continue;
+            }
+            pushWait(processed, result);
+            ++tally.images;
+        }
+        computeLeft.fetch_sub(1, std::memory_order_release);
+    };
+
+    auto encodeLoop = [&](int e) {
+        ThreadTally& tally = encodeTally[e];
+        FileManager result;
+        while (popWait(processed, computeLeft, result)) {
+            auto start = std::chrono::steady_clock::now();
+            bool saved = result.saveImage(outputPath);
+            tally.busySeconds += secondsSince(start);
+            if (!saved) {
+                std::cerr << "Error: Failed to save " << outputPath << result.getFilename() << "\n";
+                ++tally.failed;
+                continue;
+            }
+            // Results are input-sized, so this counts the input pixels of saved images only
+            tally.megapixels += static_cast<double>(result.getWidth()) * result.getHeight() / 1e6;
+            ++tally.images;
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int d = 0; d < decoders; ++d) threads.emplace_back(decodeLoop, d);
+    for (int w = 1; w < computeWorkers; ++w) threads.emplace_back(computeLoop, w);
+    for (int e = 0; e < encoders; ++e) threads.emplace_back(encodeLoop, e);
+    if (!config.threadCPUs.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : config.threadCPUs) CPU_SET(cpu, &set);
+        for (std::thread& thread : threads) pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+    }
+    computeLoop(0);
+    for (std::thread& thread : threads) thread.join();
+
+    BatchPipelineStats stats;
+    stats.wallSeconds = secondsSince(start);
+    auto sum = [&](const std::vector<ThreadTally>& tallies, BatchStageStats& stage) {
+        stage.threads = tallies.size();
+        for (const ThreadTally& tally : tallies) {
+            stage.images += tally.images;
+            stage.busySeconds += tally.busySeconds;
+            stats.failed += tally.failed;
+            stats.megapixels += tally.megapixels;
+        }
+    };
+    sum(decodeTally, stats.decode);
+    sum(computeTally, stats.compute);
+    sum(encodeTally, stats.encode);
+    return stats;
+}
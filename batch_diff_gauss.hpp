@@ -0,0 +1,133 @@
+#ifndef BATCH_DIFF_GAUSS_H
+#define BATCH_DIFF_GAUSS_H
+
+#include "file_manager.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Batch processing as a three-stage pipeline: decoder threads (stbi_load),
+// XDoG workers (any backend) and encoder threads (stbi_write_png) hand images
+// on through bounded queues, so decoding and encoding overlap the compute.
+
+// Lock-free bounded multi-producer multi-consumer queue: a ring of cells,
+// each with a sequence number that tells producers and consumers whose turn
+// the cell is (D. Vyukov's bounded MPMC queue). Head and tail are claimed
+// with a compare-and-swap, so no thread ever blocks inside the queue; callers
+// decide how to wait when it is full or empty.
+template <typename T>
+class BoundedQueue {
+public:
+    // Capacity is rounded up to a power of two
+    explicit BoundedQueue(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        cells.reset(new Cell[size]);
+        mask = size - 1;
+        for (size_t i = 0; i < size; ++i) cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // Moves 'value' in; false (value untouched) if the queue is full
+    bool tryPush(T& value) {
+        Cell* cell;
+        size_t pos = tail.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells[pos & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Moves the oldest element out into 'value'; false if the queue is empty
+    bool tryPop(T& value) {
+        Cell* cell;
+        size_t pos = head.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &cells[pos & mask];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->value);
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> head{0}; // Next cell to pop
+    alignas(64) std::atomic<size_t> tail{0}; // Next cell to push
+};
+
+// Threads per stage and queue sizes
+struct BatchPipelineConfig {
+    int decoders = 1;
+    int computeWorkers = 1; // Worker 0 runs on the calling thread
+    int encoders = 1;
+    int queueDepth = 4;     // Images waiting between two stages, bounds memory in flight
+    // CPUs the pipeline's own threads are bound to (empty = inherit the
+    // caller's affinity). The calling thread keeps its affinity.
+    std::vector<int> threadCPUs;
+};
+
+// Time one stage's threads spent working (not waiting on a queue)
+struct BatchStageStats {
+    int threads = 0;
+    int images = 0;          // Handed on (or saved, for the encoders)
+    double busySeconds = 0.0;
+
+    // Fraction of the stage's thread time spent working over 'wallSeconds'
+    double utilisation(double wallSeconds) const {
+        return threads > 0 && wallSeconds > 0.0 ? busySeconds / (threads * wallSeconds) : 0.0;
+    }
+};
+
+struct BatchPipelineStats {
+    BatchStageStats decode;
+    BatchStageStats compute;
+    BatchStageStats encode;
+    int failed = 0;          // Inputs that failed to load, process or save
+    double megapixels = 0.0; // Input pixels of the images saved
+    double wallSeconds = 0.0;
+};
+
+// Runs every path in 'inputs' through decode -> process -> encode. 'process'
+// gets a decoded image and the number (0..computeWorkers-1) of the worker
+// calling it, for per-worker state such as workspaces, and returns the
+// result (invalid on failure) with its output filename set; results are
+// saved as PNG under 'outputPath' (a prefix, as with saveImage). Images
+// complete in no particular order.
+BatchPipelineStats runBatchPipeline(const std::vector<std::string>& inputs, const std::string& outputPath,
+                                    const std::function<FileManager(const FileManager&, int)>& process,
+                                    const BatchPipelineConfig& config = BatchPipelineConfig());
+
+#endif
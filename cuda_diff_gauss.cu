@@ -3,28 +3,35 @@
 #include <cmath>
 #include <algorithm>
 
-// --- KERNEL 1: Row Convolution (X-Axis) ---
-__global__ void d_convolve_x(float* input, float* output, int width, int height, float* kernel, int radius) {
+// --- KERNEL 1: Row Convolution with two kernels (X-Axis) ---
+// Each input sample is fetched once and feeds both kernels, so the two
+// blurs of (X)DoG share a single read of the input.
+// The radius checks depend only on k, so the whole warp takes the same branch.
+__global__ void d_convolve_x_dual(float* input, float* output1, float* output2, int width, int height,
+                                  float* kernel1, int radius1, float* kernel2, int radius2) {
     int x = blockIdx.x * blockDim.x + threadIdx.x;
     int y = blockIdx.y * blockDim.y + threadIdx.y;
 
     if (x >= width || y >= height) return;
 
-    float sum = 0.0f;
-    
-    // Iterate over kernel
-    for (int k = -radius; k <= radius; k++) {
+    int maxRadius = max(radius1, radius2);
+    float sum1 = 0.0f;
+    float sum2 = 0.0f;
+
+    for (int k = -maxRadius; k <= maxRadius; k++) {
         int sample_x = x + k;
 
         // Clamp to borders (Edge Handling)
         if (sample_x < 0) sample_x = 0;
         if (sample_x >= width) sample_x = width - 1;
 
-        int index = y * width + sample_x;
-        sum += input[index] * kernel[k + radius];
+        float value = input[static_cast<size_t>(y) * width + sample_x];
+        if (k >= -radius1 && k <= radius1) sum1 += value * kernel1[k + radius1];
+        if (k >= -radius2 && k <= radius2) sum2 += value * kernel2[k + radius2];
     }
 
-    output[y * width + x] = sum;
+    output1[static_cast<size_t>(y) * width + x] = sum1;
+    output2[static_cast<size_t>(y) * width + x] = sum2;
 }
 
 // --- KERNEL 2: Column Convolution (Y-Axis) ---
@@ -43,44 +50,53 @@ __global__ void d_convolve_y(float* input, float* output, int width, int height,
         if (sample_y < 0) sample_y = 0;
         if (sample_y >= height) sample_y = height - 1;
 
-        int index = sample_y * width + x;
+        size_t index = static_cast<size_t>(sample_y) * width + x;
         sum += input[index] * kernel[k + radius];
     }
 
-    output[y * width + x] = sum;
+    output[static_cast<size_t>(y) * width + x] = sum;
 }
 
-// --- KERNEL 3: Apply DoG Math (Subtraction) ---
-__global__ void d_calc_dog(float* g1, float* g2, float* output, int size, float tau) {
-    int i = blockIdx.x * blockDim.x + threadIdx.x;
-    if (i >= size) return;
+// The element-wise kernels below walk 'size' pixels in a grid-stride loop,
+// so a capped grid covers images past 2^31 pixels
+const int kElementThreads = 256;
+const size_t kMaxElementBlocks = 65535;
 
-    // DoG Formula: G1 - tau * G2
-    output[i] = g1[i] - (tau * g2[i]);
-    
-    // Optional: Add XDoG specific mix if needed as per your CPU code logic
-    // output[i] = (1.0f - tau) * g1[i] + tau * output[i];
+static int elementBlocks(size_t size) {
+    return static_cast<int>(std::min((size + kElementThreads - 1) / kElementThreads, kMaxElementBlocks));
 }
 
-// --- KERNEL 4: Apply XDoG (Subtraction + Tanh) ---
-__global__ void d_calc_xdog(float* g1, float* g2, float* output, int size, float tau, float epsilon, float phi) {
-    int i = blockIdx.x * blockDim.x + threadIdx.x;
-    if (i >= size) return;
-
-    // 1. Calculate Difference
-    float D = g1[i] - (tau * g2[i]);
-    
-    // 2. Thresholding Logic
-    float result = 0.0f;
-    if (D > epsilon) {
-        result = 1.0f;
-    } else {
-        result = 1.0f + tanh(phi * (D - epsilon));
+// --- KERNEL 3: Apply DoG Math (Subtraction) ---
+__global__ void d_calc_dog(float* g1, float* g2, float* output, size_t size, float tau) {
+    size_t stride = static_cast<size_t>(gridDim.x) * blockDim.x;
+    for (size_t i = static_cast<size_t>(blockIdx.x) * blockDim.x + threadIdx.x; i < size; i += stride) {
+        // DoG Formula: G1 - tau * G2
+        output[i] = g1[i] - (tau * g2[i]);
+
+        // Optional: Add XDoG specific mix if needed as per your CPU code logic
+        // output[i] = (1.0f - tau) * g1[i] + tau * output[i];
     }
+}
+
+// --- KERNEL 4: Apply XDoG (Subtraction + Tanh) ---
+__global__ void d_calc_xdog(float* g1, float* g2, float* output, size_t size, float tau, float epsilon, float phi) {
+    size_t stride = static_cast<size_t>(gridDim.x) * blockDim.x;
+    for (size_t i = static_cast<size_t>(blockIdx.x) * blockDim.x + threadIdx.x; i < size; i += stride) {
+        // 1. Calculate Difference
+        float D = g1[i] - (tau * g2[i]);
+
+        // 2. Thresholding Logic
+        float result = 0.0f;
+        if (D > epsilon) {
+            result = 1.0f;
+        } else {
+            result = 1.0f + tanh(phi * (D - epsilon));
+        }
 
-    // 3. Store result (0-255 scale usually, but here we keep float 0-1 or scale)
-    // Your CPU code scales by 255 at the end, let's do it here
-    output[i] = result * 255.0f; 
+        // 3. Store result (0-255 scale usually, but here we keep float 0-1 or scale)
+        // Your CPU code scales by 255 at the end, let's do it here
+        output[i] = result * 255.0f;
+    }
 }
 
 
@@ -101,119 +117,174 @@ std::vector<float> createGaussianKernel(float sigma) {
 
 // --- GPUImage Helper Implementation ---
 GPUImage::GPUImage(int w, int h) : width(w), height(h) {
-    cudaMalloc(&d_data, width * height * sizeof(float));
+    cudaMalloc(&d_data, static_cast<size_t>(width) * height * sizeof(float));
 }
 GPUImage::~GPUImage() {
     cudaFree(d_data);
 }
 void GPUImage::upload(const std::vector<float>& host_data) {
-    cudaMemcpy(d_data, host_data.data(), width * height * sizeof(float), cudaMemcpyHostToDevice);
+    cudaMemcpy(d_data, host_data.data(), static_cast<size_t>(width) * height * sizeof(float), cudaMemcpyHostToDevice);
 }
 std::vector<float> GPUImage::download() {
-    std::vector<float> host_data(width * height);
-    cudaMemcpy(host_data.data(), d_data, width * height * sizeof(float), cudaMemcpyDeviceToHost);
+    std::vector<float> host_data(static_cast<size_t>(width) * height);
+    cudaMemcpy(host_data.data(), d_data, static_cast<size_t>(width) * height * sizeof(float), cudaMemcpyDeviceToHost);
     return host_data;
 }
 
-// --- Internal Function to Run Blur on GPU ---
-void runGaussianBlur(GPUImage& img, GPUImage& temp, float sigma) {
+// --- Internal Function to Upload a Gaussian Kernel ---
+// Replaces *d_kernel (if any) with the kernel for sigma and returns its radius
+int uploadGaussianKernel(float sigma, float** d_kernel) {
     std::vector<float> h_kernel = createGaussianKernel(sigma);
-    int radius = h_kernel.size() / 2;
     int kernel_bytes = h_kernel.size() * sizeof(float);
+    if (*d_kernel) cudaFree(*d_kernel);
+    cudaMalloc(d_kernel, kernel_bytes);
+    cudaMemcpy(*d_kernel, h_kernel.data(), kernel_bytes, cudaMemcpyHostToDevice);
+    return h_kernel.size() / 2;
+}
 
-    // Alloc kernel on GPU
-    float* d_kernel;
-    cudaMalloc(&d_kernel, kernel_bytes);
-    cudaMemcpy(d_kernel, h_kernel.data(), kernel_bytes, cudaMemcpyHostToDevice);
-
-    // Calculate Grid/Block
+// --- Internal Function to Run Two Blurs on GPU from a Single Read ---
+// On entry img1 holds the input. On exit img1 = blur(kernel1), img2 = blur(kernel2).
+// The kernels are already on the GPU.
+void runGaussianBlurDual(GPUImage& img1, GPUImage& img2, GPUImage& temp,
+                         float* d_kernel1, int radius1, float* d_kernel2, int radius2) {
     dim3 block(16, 16);
-    dim3 grid((img.width + block.x - 1) / block.x, (img.height + block.y - 1) / block.y);
+    dim3 grid((img1.width + block.x - 1) / block.x, (img1.height + block.y - 1) / block.y);
 
-    // Pass 1: Convolve X (Read img -> Write temp)
-    d_convolve_x<<<grid, block>>>(img.d_data, temp.d_data, img.width, img.height, d_kernel, radius);
+    // Pass 1: Convolve X with both kernels (Read img1 once -> Write temp, img2)
+    d_convolve_x_dual<<<grid, block>>>(img1.d_data, temp.d_data, img2.d_data, img1.width, img1.height,
+                                       d_kernel1, radius1, d_kernel2, radius2);
     cudaDeviceSynchronize();
 
-    // Pass 2: Convolve Y (Read temp -> Write img)
-    d_convolve_y<<<grid, block>>>(temp.d_data, img.d_data, img.width, img.height, d_kernel, radius);
+    // Pass 2: Convolve Y for sigma1 (Read temp -> Write img1, the input is no longer needed)
+    d_convolve_y<<<grid, block>>>(temp.d_data, img1.d_data, img1.width, img1.height, d_kernel1, radius1);
+
+    // Pass 3: Convolve Y for sigma2 (Read img2 -> Write temp), then swap so img2 holds the result
+    d_convolve_y<<<grid, block>>>(img2.d_data, temp.d_data, img2.width, img2.height, d_kernel2, radius2);
     cudaDeviceSynchronize();
+    std::swap(img2.d_data, temp.d_data);
+}
 
-    cudaFree(d_kernel);
+// Same, uploading the kernels for sigma1 and sigma2 for this call only
+void runGaussianBlurDual(GPUImage& img1, GPUImage& img2, GPUImage& temp, float sigma1, float sigma2) {
+    float* d_kernel1 = nullptr;
+    float* d_kernel2 = nullptr;
+    int radius1 = uploadGaussianKernel(sigma1, &d_kernel1);
+    int radius2 = uploadGaussianKernel(sigma2, &d_kernel2);
+
+    runGaussianBlurDual(img1, img2, temp, d_kernel1, radius1, d_kernel2, radius2);
+
+    cudaFree(d_kernel1);
+    cudaFree(d_kernel2);
 }
 
 // --- HELPER: Convert FileManager to Floats ---
-std::vector<float> fmToFloat(const FileManager& input) {
-    int w = input.getWidth();
-    int h = input.getHeight();
-    int c = input.getChannels();
-    std::vector<unsigned char> raw = input.getImageData();
-    std::vector<float> data(w * h);
-
-    for (int i = 0; i < w * h; ++i) {
-        if (c == 1) {
-            data[i] = (float)raw[i];
-        } else {
-            // Luminosity method for RGB
-            int idx = i * c;
-            data[i] = 0.299f * raw[idx] + 0.587f * raw[idx+1] + 0.114f * raw[idx+2];
+// Into 'data', resized to the pixel count (its capacity is kept)
+void fmToFloat(const FileManager& input, std::vector<float>& data) {
+    // Read the pixels in place, no copy of the byte buffer
+    PixelView raw = input.getPixelView();
+    int w = raw.width;
+    int h = raw.height;
+    int c = raw.channels;
+    data.resize(static_cast<size_t>(w) * h);
+
+    for (int y = 0; y < h; ++y) {
+        const unsigned char* row = raw.row(y);
+        for (int x = 0; x < w; ++x) {
+            size_t i = static_cast<size_t>(y) * w + x;
+            if (c < 3) {
+                data[i] = (float)row[x * c];
+            } else {
+                // Luminosity method for RGB
+                int idx = x * c;
+                data[i] = 0.299f * row[idx] + 0.587f * row[idx+1] + 0.114f * row[idx+2];
+            }
         }
     }
+}
+
+std::vector<float> fmToFloat(const FileManager& input) {
+    std::vector<float> data;
+    fmToFloat(input, data);
     return data;
 }
 
 // --- HELPER: Convert Floats to FileManager ---
-FileManager* floatToFM(const std::vector<float>& data, int w, int h) {
-    std::vector<unsigned char> bytes(w * h);
-    for (int i = 0; i < w * h; i++) {
+FileManager floatToFM(const std::vector<float>& data, int w, int h) {
+    // Quantize straight into the buffer the FileManager adopts, no extra copy
+    unsigned char* bytes = FileManager::allocateImageData(static_cast<size_t>(w) * h);
+    if (!bytes) return FileManager();
+    for (size_t i = 0; i < data.size(); i++) {
         float val = data[i];
         if (val < 0.0f) val = 0.0f;
         if (val > 255.0f) val = 255.0f;
         bytes[i] = (unsigned char)val;
     }
-    // Assumes FileManager has constructor: FileManager(unsigned char* data, int w, int h, int c)
-    return new FileManager(bytes.data(), w, h, 1);
+    return FileManager(bytes, w, h, 1, FileManager::AdoptBuffer());
 }
 
 
+// --- Reusable GPU State ---
+CUDAWorkspace::~CUDAWorkspace() {
+    if (d_kernel1) cudaFree(d_kernel1);
+    if (d_kernel2) cudaFree(d_kernel2);
+}
+
 // --- MAIN: Apply XDoG CUDA ---
-FileManager* applyXDoG_CUDA(const FileManager& input, float sigma, float k, float tau, float epsilon, float phi) {
-    if (!input.isValid()) return nullptr;
+FileManager applyXDoG_CUDA(const FileManager& input, float sigma, float k, float tau, float epsilon, float phi,
+                           CUDAWorkspace& workspace) {
+    if (!input.isValid()) return FileManager();
     int w = input.getWidth();
     int h = input.getHeight();
+    size_t pixels = static_cast<size_t>(w) * h;
+
+    // 1. Prepare Data: buffers reallocated only for a larger image
+    if (pixels > workspace.capacity) {
+        workspace.g1.reset(new GPUImage(w, h));
+        workspace.g2.reset(new GPUImage(w, h));
+        workspace.temp.reset(new GPUImage(w, h)); // Scratchpad for convolution
+        workspace.capacity = pixels;
+    }
+    GPUImage& g1 = *workspace.g1;
+    GPUImage& g2 = *workspace.g2;
+    GPUImage& temp = *workspace.temp;
+    for (GPUImage* img : {&g1, &g2, &temp}) {
+        img->width = w;
+        img->height = h;
+    }
+    if (!workspace.d_kernel1 || workspace.sigma1 != sigma || workspace.sigma2 != k * sigma) {
+        workspace.radius1 = uploadGaussianKernel(sigma, &workspace.d_kernel1);
+        workspace.radius2 = uploadGaussianKernel(k * sigma, &workspace.d_kernel2);
+        workspace.sigma1 = sigma;
+        workspace.sigma2 = k * sigma;
+    }
 
-    // 1. Prepare Data
-    std::vector<float> h_raw = fmToFloat(input);
-    GPUImage g1(w, h);
-    GPUImage g2(w, h);
-    GPUImage temp(w, h); // Scratchpad for convolution
-
-    // Upload raw image to both g1 and g2 initially
-    g1.upload(h_raw);
-    g2.upload(h_raw);
-
-    // 2. Blur G1 (sigma)
-    runGaussianBlur(g1, temp, sigma);
+    // Upload raw image once, both blurs read it from g1
+    fmToFloat(input, workspace.h_data);
+    g1.upload(workspace.h_data);
 
-    // 3. Blur G2 (k * sigma)
-    runGaussianBlur(g2, temp, k * sigma);
+    // 2./3. Blur G1 (sigma) and G2 (k * sigma) from a single read of the input
+    runGaussianBlurDual(g1, g2, temp, workspace.d_kernel1, workspace.radius1,
+                        workspace.d_kernel2, workspace.radius2);
 
     // 4. Compute XDoG (Math + Threshold)
     // We can reuse 'temp' or 'g1' to store the output. Let's use g1.
-    int total_pixels = w * h;
-    int threads = 256;
-    int blocks = (total_pixels + threads - 1) / threads;
-
-    d_calc_xdog<<<blocks, threads>>>(g1.d_data, g2.d_data, g1.d_data, total_pixels, tau, epsilon, phi);
+    d_calc_xdog<<<elementBlocks(pixels), kElementThreads>>>(g1.d_data, g2.d_data, g1.d_data, pixels,
+                                                            tau, epsilon, phi);
     cudaDeviceSynchronize();
 
-    // 5. Download and Return
-    std::vector<float> result = g1.download();
-    return floatToFM(result, w, h);
+    // 5. Download into the staging buffer and Return
+    cudaMemcpy(workspace.h_data.data(), g1.d_data, pixels * sizeof(float), cudaMemcpyDeviceToHost);
+    return floatToFM(workspace.h_data, w, h);
+}
+
+FileManager applyXDoG_CUDA(const FileManager& input, float sigma, float k, float tau, float epsilon, float phi) {
+    CUDAWorkspace workspace;
+    return applyXDoG_CUDA(input, sigma, k, tau, epsilon, phi, workspace);
 }
 
 // --- MAIN: Apply DoG CUDA (Without Threshold) ---
-FileManager* applyDoG_CUDA(const FileManager& input, float sigma, float k, float tau) {
-    if (!input.isValid()) return nullptr;
+FileManager applyDoG_CUDA(const FileManager& input, float sigma, float k, float tau) {
+    if (!input.isValid()) return FileManager();
     int w = input.getWidth();
     int h = input.getHeight();
 
@@ -223,16 +294,11 @@ FileManager* applyDoG_CUDA(const FileManager& input, float sigma, float k, float
     GPUImage temp(w, h);
 
     g1.upload(h_raw);
-    g2.upload(h_raw);
-
-    runGaussianBlur(g1, temp, sigma);
-    runGaussianBlur(g2, temp, k * sigma);
 
-    int total_pixels = w * h;
-    int threads = 256;
-    int blocks = (total_pixels + threads - 1) / threads;
+    runGaussianBlurDual(g1, g2, temp, sigma, k * sigma);
 
-    d_calc_dog<<<blocks, threads>>>(g1.d_data, g2.d_data, g1.d_data, total_pixels, tau);
+    size_t total_pixels = static_cast<size_t>(w) * h;
+    d_calc_dog<<<elementBlocks(total_pixels), kElementThreads>>>(g1.d_data, g2.d_data, g1.d_data, total_pixels, tau);
     cudaDeviceSynchronize();
 
     std::vector<float> result = g1.download();
@@ -2,6 +2,7 @@
 #define CUDA_DIFF_GAUSS_H
 
 #include "file_manager.h"
+#include <memory>
 #include <vector>
 #include <cuda_runtime.h>
 
@@ -22,14 +23,43 @@ struct GPUImage {
     std::vector<float> download();
 };
 
+// --- Reusable GPU State ---
+// Device buffers and kernels kept across applyXDoG_CUDA calls, so a batch of
+// images pays cudaMalloc and the kernel uploads once instead of per image.
+// Buffers grow to the largest image seen; kernels are uploaded again only
+// when sigma or k change.
+struct CUDAWorkspace {
+    std::unique_ptr<GPUImage> g1;
+    std::unique_ptr<GPUImage> g2;
+    std::unique_ptr<GPUImage> temp;
+    size_t capacity = 0; // Pixels each buffer holds
+
+    float* d_kernel1 = nullptr;
+    float* d_kernel2 = nullptr;
+    float sigma1 = 0.0f;
+    float sigma2 = 0.0f;
+    int radius1 = 0;
+    int radius2 = 0;
+
+    std::vector<float> h_data; // Host staging for upload and download
+
+    CUDAWorkspace() {}
+    ~CUDAWorkspace();
+    CUDAWorkspace(const CUDAWorkspace&) = delete;
+    CUDAWorkspace& operator=(const CUDAWorkspace&) = delete;
+};
+
 // --- Main CUDA Functions ---
 
 // Applies Difference of Gaussians on GPU
-// Returns a pointer to a NEW FileManager object (must be deleted by user)
-FileManager* applyDoG_CUDA(const FileManager& input, float sigma, float k, float tau);
+// Returns the result by value (invalid FileManager on failure)
+FileManager applyDoG_CUDA(const FileManager& input, float sigma, float k, float tau);
 
 // Applies XDoG (Extended DoG) with tanh thresholding on GPU
-// Returns a pointer to a NEW FileManager object (must be deleted by user)
-FileManager* applyXDoG_CUDA(const FileManager& input, float sigma, float k, float tau, float epsilon, float phi);
+// Returns the result by value (invalid FileManager on failure)
+FileManager applyXDoG_CUDA(const FileManager& input, float sigma, float k, float tau, float epsilon, float phi);
+// Same, with device buffers and kernels taken from 'workspace'
+FileManager applyXDoG_CUDA(const FileManager& input, float sigma, float k, float tau, float epsilon, float phi,
+                           CUDAWorkspace& workspace);
 
 #endif
\ No newline at end of file
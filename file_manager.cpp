@@ -3,6 +3,7 @@
 #include <fstream>
 #include <cstring> 
 #include <filesystem>
+#include <utility>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -10,6 +11,15 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
+FileManager::FileManager() {
+    text_data = nullptr;
+    image_data = nullptr;
+    width = 0; height = 0; channels = 0;
+    data_size = 0;
+    valid = false;
+    is_image = false;
+}
+
 FileManager::FileManager(const std::string& filepath, const std::string& type) {
     // 1. Initialize all pointers to nullptr to prevent crashes
     text_data = nullptr;
@@ -29,7 +39,7 @@ FileManager::FileManager(const std::string& filepath, const std::string& type) {
         
         if (image_data) {
             valid = true;
-            data_size = width * height * channels;
+            data_size = static_cast<size_t>(width) * height * channels;
 
             
         } else {
@@ -74,7 +84,7 @@ FileManager::FileManager(const unsigned char* input_data, int w, int h, int c) {
     channels = c;
     is_image = true;
     file_type = "image";
-    data_size = width * height * channels;
+    data_size = static_cast<size_t>(width) * height * channels;
     filename = "";
 
     // DEEP COPY: Allocate new memory and copy the input data into it.
@@ -93,7 +103,34 @@ FileManager::FileManager(const unsigned char* input_data, int w, int h, int c) {
     }
 }
 
+FileManager::FileManager(unsigned char* owned_data, int w, int h, int c, AdoptBuffer) {
+    text_data = nullptr;
+    image_data = owned_data;
+
+    width = w;
+    height = h;
+    channels = c;
+    is_image = true;
+    file_type = "image";
+    data_size = static_cast<size_t>(width) * height * channels;
+    filename = "";
+    valid = (image_data != nullptr && data_size > 0);
+}
+
+unsigned char* FileManager::allocateImageData(size_t size) {
+    // malloc, because the destructor releases image data with stbi_image_free
+    unsigned char* data = (unsigned char*)malloc(size);
+    if (!data) {
+        std::cerr << "Error: Malloc failed in FileManager::allocateImageData" << std::endl;
+    }
+    return data;
+}
+
 FileManager::~FileManager() {
+    release();
+}
+
+void FileManager::release() {
     // If it's an image, use STB's free
     if (image_data != nullptr) {
         stbi_image_free(image_data);
@@ -107,6 +144,42 @@ FileManager::~FileManager() {
     }
 }
 
+FileManager::FileManager(FileManager&& other) noexcept
+    : text_data(other.text_data), image_data(other.image_data),
+      file_type(std::move(other.file_type)), filename(std::move(other.filename)),
+      valid(other.valid), is_image(other.is_image), data_size(other.data_size),
+      width(other.width), height(other.height), channels(other.channels) {
+    // Leave 'other' empty so its destructor frees nothing
+    other.text_data = nullptr;
+    other.image_data = nullptr;
+    other.valid = false;
+    other.data_size = 0;
+    other.width = 0; other.height = 0; other.channels = 0;
+}
+
+FileManager& FileManager::operator=(FileManager&& other) noexcept {
+    if (this != &other) {
+        release();
+        text_data = other.text_data;
+        image_data = other.image_data;
+        file_type = std::move(other.file_type);
+        filename = std::move(other.filename);
+        valid = other.valid;
+        is_image = other.is_image;
+        data_size = other.data_size;
+        width = other.width;
+        height = other.height;
+        channels = other.channels;
+
+        other.text_data = nullptr;
+        other.image_data = nullptr;
+        other.valid = false;
+        other.data_size = 0;
+        other.width = 0; other.height = 0; other.channels = 0;
+    }
+    return *this;
+}
+
 bool FileManager::isValid() const {
     return valid;
 }
@@ -152,6 +225,19 @@ std::vector<unsigned char> FileManager::getImageData() const {
     return std::vector<unsigned char>();
 }
 
+PixelView FileManager::getPixelView() const {
+    PixelView view;
+    if (is_image && image_data != nullptr && data_size > 0) {
+        view.data = image_data;
+        view.size = data_size;
+        view.width = width;
+        view.height = height;
+        view.channels = channels;
+        view.stride = static_cast<size_t>(width) * channels;
+    }
+    return view;
+}
+
 bool FileManager::saveImage(const std::string& filepath) const {
     if (!valid || !is_image || !image_data) return false;
 
@@ -174,16 +260,16 @@ bool FileManager::toBWImage() {
 
     // 2. Allocate new memory for 1-channel image
     // New size is just width * height (since 1 byte per pixel)
-    size_t new_data_size = width * height;
+    size_t new_data_size = static_cast<size_t>(width) * height;
     unsigned char* new_data = (unsigned char*)malloc(new_data_size);
 
     if (new_data == nullptr) return false; // Allocation failed
 
     // 3. Convert Pixels
     // We iterate through every pixel
-    for (int i = 0; i < width * height; i++) {
+    for (size_t i = 0; i < new_data_size; i++) {
         // Calculate where this pixel starts in the OLD (RGB) array
-        int old_index = i * channels; 
+        size_t old_index = i * channels; 
 
         unsigned char r = image_data[old_index];
         unsigned char g = image_data[old_index + 1];
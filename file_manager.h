@@ -4,6 +4,20 @@
 #include <string>
 #include <vector>
 
+// Non-owning, read-only view of decoded pixels (interleaved, 8 bits per channel).
+// Valid as long as the FileManager it came from is alive and unmodified.
+struct PixelView {
+    const unsigned char* data = nullptr;
+    size_t size = 0;    // Bytes in the view
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    size_t stride = 0;  // Bytes from one row to the next
+
+    const unsigned char* row(int y) const { return data + static_cast<size_t>(y) * stride; }
+    bool empty() const { return data == nullptr; }
+};
+
 class FileManager {
     private:
     unsigned char* text_data;
@@ -18,13 +32,35 @@ class FileManager {
     int height;
     int channels;
     
+    void release();
+
     public:
+    // Empty, invalid FileManager (e.g. a failed result or a slot to move into)
+    FileManager();
     FileManager(const std::string& filepath, const std::string& type);
     FileManager(const unsigned char* image_data, int width, int height, int channels);
+
+    // Ownership-transferring constructor: adopts 'owned_data' (which must come
+    // from allocateImageData) without copying it, and frees it on destruction.
+    struct AdoptBuffer {};
+    FileManager(unsigned char* owned_data, int width, int height, int channels, AdoptBuffer);
+    // Uninitialised pixel buffer of 'size' bytes, freed the way ~FileManager frees
+    static unsigned char* allocateImageData(size_t size);
+
     ~FileManager();
 
+    // Sole owner of its buffers: movable, never copied (use getImageData()
+    // or the copying constructor for an explicit deep copy)
+    FileManager(const FileManager&) = delete;
+    FileManager& operator=(const FileManager&) = delete;
+    FileManager(FileManager&& other) noexcept;
+    FileManager& operator=(FileManager&& other) noexcept;
+
     std::vector<unsigned char> getTextData() const;
+    // Owning copy of the pixels; readers should prefer getPixelView()
     std::vector<unsigned char> getImageData() const;
+    // Zero-copy access to the pixels (empty view if this is not an image)
+    PixelView getPixelView() const;
 
     bool toBWImage();
     bool saveImage(const std::string& filepath) const;
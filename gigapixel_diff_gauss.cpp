@@ -0,0 +1,187 @@
+#include "gigapixel_diff_gauss.hpp"
+#include "omp_diff_gauss.hpp"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cctype>
+#include <limits>
+#include <vector>
+
+// Reuse kernel generator
+extern std::vector<float> create1dGaussianKernel(float sigma);
+
+// Float planes a tile occupies in the workspace: the luma region, g1, g2 and
+// the two horizontal-pass planes (the result reuses temp1)
+static const int kGigapixelPlanes = 5;
+
+// Skips whitespace and '#' comments between PNM header fields
+static void skipPNMSeparators(std::istream& in) {
+    int c;
+    while ((c = in.peek()) != EOF) {
+        if (c == '#') {
+            in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        } else if (std::isspace(c)) {
+            in.get();
+        } else {
+            break;
+        }
+    }
+}
+
+bool readPNMHeader(std::istream& in, PNMHeader& header) {
+    char magic[2];
+    if (!in.read(magic, 2) || magic[0] != 'P' || (magic[1] != '5' && magic[1] != '6')) return false;
+
+    int maxval = 0;
+    skipPNMSeparators(in);
+    in >> header.width;
+    skipPNMSeparators(in);
+    in >> header.height;
+    skipPNMSeparators(in);
+    in >> maxval;
+    // Exactly one whitespace byte separates the header from the pixels
+    if (!in || !std::isspace(in.get())) return false;
+    if (header.width <= 0 || header.height <= 0 || maxval <= 0 || maxval > 255) return false;
+
+    header.channels = (magic[1] == '5') ? 1 : 3;
+    header.dataOffset = in.tellg();
+    return header.dataOffset > 0;
+}
+
+// Reach of one blur of 'sigma' under the mode these options select for it
+static int blurSupport(float sigma, const XDoGOptions& options) {
+    if (options.blurMode == BlurMode::Box) {
+        int support = 0;
+        for (int radius : boxRadiiForGauss(sigma, options.boxPasses)) support += radius;
+        return support;
+    }
+    if (useRecursiveBlur(options, sigma)) return computeIIRCoefficients(sigma).pad;
+    return create1dGaussianKernel(sigma).size() / 2;
+}
+
+int xdogHalo(float sigma, float k, const XDoGOptions& options) {
+    XDoGOptions pair = resolveBlurPair(options, sigma, k);
+    int support1 = blurSupport(sigma, pair);
+    int support2 = blurSupport(sigma * k, pair);
+    if (options.blurMode == BlurMode::Cascaded && k > 1.0f) {
+        // g2 is g1 blurred again by the residual
+        int residual = create1dGaussianKernel(cascadeSigma(sigma * k, sigma)).size() / 2;
+        support2 = std::max(support2, support1 + residual);
+    }
+    return std::max(support1, support2);
+}
+
+GigapixelPlan planGigapixelTiles(int width, int height, float sigma, float k, const XDoGOptions& options,
+                                 size_t budgetBytes) {
+    GigapixelPlan plan;
+    plan.halo = xdogHalo(sigma, k, options);
+    int halo = plan.halo;
+
+    // Region pixels that fit, with rows counted at their padded stride
+    size_t budgetPixels = budgetBytes / (kGigapixelPlanes * sizeof(float));
+    size_t paddedWidth = Image::paddedStride(width, 0);
+    size_t stripRows = budgetPixels / paddedWidth;
+
+    if (stripRows >= static_cast<size_t>(height)) {
+        plan.tileWidth = width;
+        plan.tileHeight = height;
+    } else if (stripRows >= static_cast<size_t>(2 * halo + 16)) {
+        plan.tileWidth = width;
+        plan.tileHeight = static_cast<int>(stripRows) - 2 * halo;
+    } else {
+        // Square tiles; the stride pads each region row by up to 16 floats
+        int edge = static_cast<int>(std::sqrt(static_cast<double>(budgetPixels))) - 16;
+        int tile = (edge - 2 * halo) / 16 * 16;
+        if (tile < 16) return plan;
+        plan.tileWidth = std::min(tile, width);
+        plan.tileHeight = std::min(tile, height);
+    }
+
+    plan.tilesX = (width + plan.tileWidth - 1) / plan.tileWidth;
+    plan.tilesY = (height + plan.tileHeight - 1) / plan.tileHeight;
+    size_t regionW = Image::paddedStride(std::min(plan.tileWidth + 2 * halo, width), 0);
+    size_t regionH = std::min(plan.tileHeight + 2 * halo, height);
+    plan.tileBytes = regionW * regionH * kGigapixelPlanes * sizeof(float);
+    return plan;
+}
+
+bool applyXDoGGigapixel(const std::string& inputPath, const std::string& outputPath, float sigma, float k, float p,
+                        float epsilon, float phi, const XDoGOptions& options, size_t budgetBytes,
+                        GigapixelPlan* planOut) {
+    std::ifstream src(inputPath, std::ios::binary);
+    PNMHeader header;
+    if (!src.is_open() || !readPNMHeader(src, header)) {
+        std::cerr << "Error: " << inputPath << " is not a readable binary PNM (P5/P6, 8-bit)" << std::endl;
+        return false;
+    }
+    int w = header.width;
+    int h = header.height;
+    int c = header.channels;
+
+    GigapixelPlan plan = planGigapixelTiles(w, h, sigma, k, options, budgetBytes);
+    if (planOut) *planOut = plan;
+    if (plan.tileWidth == 0) {
+        std::cerr << "Error: Memory budget too small for a tile plus its " << plan.halo << " px halo" << std::endl;
+        return false;
+    }
+
+    // Header, then the file extended to its final size so tiles land at their offsets
+    std::ofstream dst(outputPath, std::ios::binary | std::ios::trunc);
+    if (!dst.is_open()) {
+        std::cerr << "Error: Failed to create " << outputPath << std::endl;
+        return false;
+    }
+    dst << "P5\n" << w << " " << h << "\n255\n";
+    std::streamoff outOffset = dst.tellp();
+    std::streamoff pixelCount = static_cast<std::streamoff>(w) * h;
+    dst.seekp(outOffset + pixelCount - 1);
+    dst.put(0);
+
+    // Tiles reuse one workspace: the region lands in luma, the result in temp1
+    XDoGWorkspace workspace;
+    Image& region = workspace.luma;
+    Image& result = workspace.temp1;
+    std::vector<unsigned char> rawRow(static_cast<size_t>(std::min(plan.tileWidth + 2 * plan.halo, w)) * c);
+    std::vector<unsigned char> outRow(plan.tileWidth);
+    int halo = plan.halo;
+
+    for (int ty0 = 0; ty0 < h; ty0 += plan.tileHeight) {
+        for (int tx0 = 0; tx0 < w; tx0 += plan.tileWidth) {
+            int tw = std::min(plan.tileWidth, w - tx0);
+            int th = std::min(plan.tileHeight, h - ty0);
+
+            // Tile plus halo, clipped to the image where the kernels clamp anyway
+            int rx0 = std::max(tx0 - halo, 0);
+            int ry0 = std::max(ty0 - halo, 0);
+            int rw = std::min(tx0 + tw + halo, w) - rx0;
+            int rh = std::min(ty0 + th + halo, h) - ry0;
+            region.resize(rw, rh);
+
+            for (int y = 0; y < rh; ++y) {
+                std::streamoff pixel = static_cast<std::streamoff>(ry0 + y) * w + rx0;
+                src.seekg(header.dataOffset + pixel * c);
+                if (!src.read(reinterpret_cast<char*>(rawRow.data()), static_cast<std::streamsize>(rw) * c)) {
+                    std::cerr << "Error: " << inputPath << " is truncated" << std::endl;
+                    return false;
+                }
+                luma_row(rawRow.data(), region.row(y), rw, c);
+            }
+
+            applyXDoG_OMP(region, result, sigma, k, p, epsilon, phi, options, workspace);
+
+            // Only the tile's own pixels are written, halo outputs are discarded
+            int ox = tx0 - rx0;
+            for (int y = ty0; y < ty0 + th; ++y) {
+                quantize_row(result.row(y - ry0) + ox, outRow.data(), tw);
+                dst.seekp(outOffset + static_cast<std::streamoff>(y) * w + tx0);
+                dst.write(reinterpret_cast<const char*>(outRow.data()), tw);
+            }
+            if (!dst) {
+                std::cerr << "Error: Failed to write " << outputPath << std::endl;
+                return false;
+            }
+        }
+    }
+    return true;
+}
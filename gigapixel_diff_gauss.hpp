@@ -0,0 +1,60 @@
+#ifndef GIGAPIXEL_DIFF_GAUSS_H
+#define GIGAPIXEL_DIFF_GAUSS_H
+
+#include "seq_diff_gauss.hpp" // Image, XDoGOptions, XDoGWorkspace
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+
+// Out-of-core XDoG for images larger than memory. Input and output are binary
+// PNM files (P5 gray / P6 RGB in, P5 out, 8 bits per sample), which can be
+// read and written at any pixel offset; PNG has to be decoded whole. Tiles
+// plus a halo are read from disk, run through applyXDoG_OMP and their
+// interiors written straight to their place in the output file. All file
+// offsets are 64-bit, so the pixel count is not limited to 2^31.
+
+// Header of a binary PNM file
+struct PNMHeader {
+    int width = 0;
+    int height = 0;
+    int channels = 0;           // 1 (P5) or 3 (P6)
+    std::streamoff dataOffset = 0; // Bytes before the first pixel
+};
+
+// Parses a P5/P6 header with maxval <= 255 (comments allowed). The stream is
+// left at the first pixel.
+bool readPNMHeader(std::istream& in, PNMHeader& header);
+
+// Tiling chosen for an image under a memory budget
+struct GigapixelPlan {
+    int tileWidth = 0;  // 0 if the budget cannot hold a tile plus its halo
+    int tileHeight = 0;
+    int halo = 0;       // Input pixels read around each tile
+    int tilesX = 0;
+    int tilesY = 0;
+    size_t tileBytes = 0; // Working set of one tile (float planes)
+};
+
+// Pixels outside a tile that reach its XDoG result under 'options': the
+// larger kernel radius for direct blurs, g1's radius plus the residual's when
+// cascaded, the stacked box radii for box blurs. The recursive filter has
+// infinite support; its halo is the edge extension after which the response
+// has decayed to 1e-4, so tile seams agree with the whole-image result only
+// to within that.
+int xdogHalo(float sigma, float k, const XDoGOptions& options);
+
+// Tiles for a width x height image whose per-tile working set stays within
+// 'budgetBytes'. Full-width strips when they fit (one contiguous read per
+// row), square tiles otherwise.
+GigapixelPlan planGigapixelTiles(int width, int height, float sigma, float k, const XDoGOptions& options,
+                                 size_t budgetBytes);
+
+// XDoG of the PNM at 'inputPath' into an 8-bit P5 at 'outputPath', tile by
+// tile. Peak memory is the budget plus a few rows. 'plan', if given, receives
+// the tiling used. Returns false (with a message) on I/O errors or a budget
+// too small for the halo.
+bool applyXDoGGigapixel(const std::string& inputPath, const std::string& outputPath, float sigma, float k, float p,
+                        float epsilon, float phi, const XDoGOptions& options, size_t budgetBytes,
+                        GigapixelPlan* plan = nullptr);
+
+#endif
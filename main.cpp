@@ -3,11 +3,22 @@
 #include <sstream>
 #include <fstream>
 #include <vector>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+#include <memory>
+#include <filesystem>
 #include <omp.h>
+#include <sched.h>
 
 #include "file_manager.h"
 #include "seq_diff_gauss.hpp"
 #include "omp_diff_gauss.hpp" 
+#include "vec_diff_gauss.hpp"
+#include "stream_diff_gauss.hpp"
+#include "gigapixel_diff_gauss.hpp"
+#include "pool_diff_gauss.hpp"
+#include "batch_diff_gauss.hpp"
 #include "cuda_diff_gauss.cuh"
 
 // Helper function to read floats from the shader text file
@@ -28,11 +39,48 @@ void printUsage(const std::string& programName) {
     std::cout   << "Usage: " << programName << " [options]\n"
                 << "Options:\n"
                 << "  -h, --help       Show this help message and exit\n"
-                << "  --GPU, -g        Use GPU (CUDA) for processing\n"
+                << "  --GPU, -g        Use GPU (CUDA) for processing (direct blur and libm tanh only)\n"
                 << "  --omp            Use CPU Parallelism (OpenMP)\n"
+                << "  --vec            Use CPU Vectorization (SSE4.2/AVX2/AVX-512, picked at runtime)\n"
+                << "  --stream         Stream rows through ring buffers (memory ~ width x kernel height);\n"
+                << "                   direct blur only, other blurs and quality tiers are rejected\n"
+                << "  --gigapixel      Out-of-core: stream tiles of a binary PNM (P5/P6) input from disk\n"
+                << "                   into a P5 output, peak memory bounded by --budget\n"
+                << "  --budget <MB>    Gigapixel only: memory budget for a tile's working set (default 256)\n"
+                << "  --pool           Use the built-in work-stealing thread pool instead of OpenMP\n"
+                << "  --threads <n>    Pool only: threads including the caller (default: all CPUs)\n"
                 << "  --input <file>   Specify input file location\n"
+                << "  --batch <src>    Instead of --input: process every image in directory <src>, or every\n"
+                << "                   path listed in file <src> (one per line, '#' comments), in one run,\n"
+                << "                   reusing buffers and kernels; reports images/s, MP/s and per-stage\n"
+                << "                   utilisation\n"
+                << "  --stages <d,c,e> Batch only: decoder threads, XDoG workers and encoder threads of the\n"
+                << "                   batch pipeline (default 1,1,1); each XDoG worker runs the backend\n"
+                << "                   with its own threads, so c > 1 suits the single-threaded backends\n"
                 << "  --output <file>  Specify output file location\n"
                 << "  --shader <file>  Specify shader file location (optional)\n"
+                << "  --blur <mode>    Blur engine: direct (default, FIR), cascade (g2 derived from g1),\n"
+                << "                   iir (recursive), box, or auto (iir for both blurs if sigma >= "
+                << kRecursiveSigmaThreshold << ",\n"
+                << "                   else direct; faster, but the threshold amplifies the iir blur error\n"
+                << "                   about 1 + 2p times, so edges move)\n"
+                << "  --quality <tier> exact (default, uses --blur), preview (5 stacked box blurs)\n"
+                << "                   or draft (3 stacked box blurs); preview and draft exclude --blur\n"
+                << "  --tanh <impl>    Soft threshold tanh: libm (default) or rational (inline, 3e-7 max error)\n"
+                << "  --tile <px>      OpenMP only: process in cache-sized tiles of <px> x <px>,\n"
+                << "                   or 'auto' to size them to the L2 cache (default off)\n"
+                << "  --pipeline       OpenMP only: whole direct-blur pipeline in one parallel region,\n"
+                << "                   row bands synchronised on their halo rows only\n"
+                << "  --bench <runs>   OpenMP: time plane-at-a-time vs tiled vs pipeline XDoG;\n"
+                << "                   pool: time the pool vs OpenMP; best of <runs>\n"
+                << "  --pin <mode>     OpenMP/gigapixel: bind threads per socket ('sockets'), per CPU\n"
+                << "                   ('cores') or not at all ('none', default); pool: 'cores' or 'none'\n"
+                << "  --compare        Single image, sequential/OpenMP/vector/pool: report deviation from\n"
+                << "                   the direct blur path and fail (exit non-zero) if a blur strays\n"
+                << "                   further than the tolerance, or if the backend's result is more\n"
+                << "                   than 1 level off the sequential one\n"
+                << "  --tolerance <lv> Compare only: max blur deviation in gray levels (default by blur mode:\n"
+                << "                   direct 0.01, cascade 1, iir 2, box unchecked)\n"
                 << "  --sigma <val>    XDoG Sigma (default 1.0)\n"
                 << "  --k <val>        XDoG K (default 1.6)\n"
                 << "  --tau <val>      XDoG P/Tau (Strength) (default 20.0)\n"
@@ -47,7 +95,8 @@ void getUserInput(int argc, char* argv[], std::string* flags) {
         exit(-1);
     } 
     
-    // flags[0] usage: "0"=Sequential, "1"=CUDA, "2"=OpenMP
+    // flags[0] usage: "0"=Sequential, "1"=CUDA, "2"=OpenMP, "3"=Vector, "4"=Streaming, "5"=Gigapixel,
+    // "6"=Thread pool
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
         if (arg == "--GPU" || arg == "-g") {
@@ -56,6 +105,18 @@ void getUserInput(int argc, char* argv[], std::string* flags) {
         else if (arg == "--omp") {
             flags[0] = "2"; // OpenMP Mode
         }
+        else if (arg == "--vec") {
+            flags[0] = "3"; // Vector Mode
+        }
+        else if (arg == "--stream") {
+            flags[0] = "4"; // Streaming Mode
+        }
+        else if (arg == "--gigapixel") {
+            flags[0] = "5"; // Gigapixel Mode
+        }
+        else if (arg == "--pool") {
+            flags[0] = "6"; // Thread Pool Mode
+        }
         else if (arg == "--input") {
             flags[1] = "1"; 
             i++;
@@ -71,22 +132,150 @@ void getUserInput(int argc, char* argv[], std::string* flags) {
             i++;
             if (i < argc) flags[6] = argv[i];
         }
+        else if (arg == "--blur") {
+            i++;
+            if (i < argc) flags[7] = argv[i];
+        }
+        else if (arg == "--compare") {
+            flags[8] = "1";
+        }
+        else if (arg == "--quality") {
+            i++;
+            if (i < argc) flags[9] = argv[i];
+        }
+        else if (arg == "--tanh") {
+            i++;
+            if (i < argc) flags[10] = argv[i];
+        }
+        else if (arg == "--tile") {
+            i++;
+            if (i < argc) flags[11] = argv[i];
+        }
+        else if (arg == "--bench") {
+            i++;
+            if (i < argc) flags[12] = argv[i];
+        }
+        else if (arg == "--budget") {
+            i++;
+            if (i < argc) flags[13] = argv[i];
+        }
+        else if (arg == "--pin") {
+            i++;
+            if (i < argc) flags[14] = argv[i];
+        }
+        else if (arg == "--pipeline") {
+            flags[15] = "1";
+        }
+        else if (arg == "--threads") {
+            i++;
+            if (i < argc) flags[16] = argv[i];
+        }
+        else if (arg == "--batch") {
+            i++;
+            if (i < argc) flags[17] = argv[i];
+        }
+        else if (arg == "--stages") {
+            i++;
+            if (i < argc) flags[18] = argv[i];
+        }
+        else if (arg == "--tolerance") {
+            i++;
+            if (i < argc) flags[19] = argv[i];
+        }
     }
 
-    if (flags[1] == "0" || flags[3] == "0") {
+    if ((flags[1] == "0" && flags[17].empty()) || flags[3] == "0") {
         std::cerr << "Error: Missing required options (Input or Output).\n";
         printUsage(argv[0]);
         exit(-1);
     }
 }
 
+// Default bound (0-255 scale) on how far --compare lets the blurs stray from
+// the direct path, from the accuracy of the engine 'options' picks; negative
+// = not checked (box blurs are an approximation of a different shape)
+float defaultCompareTolerance(const XDoGOptions& options, float sigma, float k) {
+    if (options.blurMode == BlurMode::Box) return -1.0f;
+    if (resolveBlurPair(options, sigma, k).blurMode == BlurMode::Recursive) return 2.0f;
+    if (options.blurMode == BlurMode::Cascaded) return 1.0f;
+    return 0.01f;
+}
+
+// Largest difference between 'a' and 'b' once both are quantized to 8 bits, as they would be saved
+int maxQuantizedDifference(ConstImageView a, ConstImageView b) {
+    std::vector<unsigned char> rowA(a.width), rowB(a.width);
+    int maxDiff = 0;
+    for (int y = 0; y < a.height; ++y) {
+        quantize_row(a.row(y), rowA.data(), a.width);
+        quantize_row(b.row(y), rowB.data(), a.width);
+        for (int x = 0; x < a.width; ++x) maxDiff = std::max(maxDiff, std::abs(rowA[x] - rowB[x]));
+    }
+    return maxDiff;
+}
+
+// Levels a backend's saved result may differ from the sequential one of the same blur mode:
+// fused and reordered float math moves values next to a rounding step by one level
+const int kBackendTolerance = 1;
+
+// Prints how far the chosen blur mode and the backend's 'result' are from the direct
+// (reference) path. Two checks: the blur mode's g1/g2 against the direct blurs, within
+// 'tolerance' (unchecked if negative), and 'result' against the sequential XDoG of the same
+// options, within kBackendTolerance, so a backend's own blurs and epilogue are gated too.
+// Returns false if either is exceeded.
+bool reportDeviation(const Image& floatImage, const Image& result, float sigma, float k, float p, float epsilon,
+                     float phi, const XDoGOptions& options, float tolerance) {
+    Image g1(floatImage.width, floatImage.height), g2(floatImage.width, floatImage.height);
+    Image refG1(floatImage.width, floatImage.height), refG2(floatImage.width, floatImage.height);
+    GaussianBlurPair(floatImage, g1, g2, sigma, k, options);
+    XDoGOptions direct;
+    direct.blurMode = BlurMode::Direct;
+    GaussianBlurPair(floatImage, refG1, refG2, sigma, k, direct);
+
+    Image reference = applyXDoG(floatImage, sigma, k, p, epsilon, phi, direct);
+    float g1Deviation = maxAbsDifference(g1, refG1);
+    float g2Deviation = maxAbsDifference(g2, refG2);
+    std::cout << "Compare -> max blur deviation from direct path: g1 " << g1Deviation
+              << ", g2 " << g2Deviation
+              << "; XDoG output: " << maxAbsDifference(result, reference) << " (0-255 scale)\n";
+    std::cout << "Compare -> PSNR against direct path: g1 " << computePSNR(g1, refG1)
+              << " dB, g2 " << computePSNR(g2, refG2)
+              << " dB; XDoG output: " << computePSNR(result, reference) << " dB\n";
+
+    bool passed = true;
+    Image expected = applyXDoG(floatImage, sigma, k, p, epsilon, phi, options);
+    int backendDeviation = maxQuantizedDifference(result, expected);
+    std::cout << "Compare -> max 8-bit deviation from the sequential result of this blur mode: "
+              << backendDeviation << "\n";
+    if (backendDeviation > kBackendTolerance) {
+        std::cerr << "Error: Backend result deviates by " << backendDeviation << " levels (tolerance "
+                  << kBackendTolerance << ").\n";
+        passed = false;
+    }
+
+    // The thresholded output flips whole pixels on tiny blur changes, so the
+    // blur mode is judged by its blurs
+    if (tolerance < 0.0f) {
+        std::cout << "Compare -> no tolerance for this blur mode, pass --tolerance to check it\n";
+        return passed;
+    }
+    float deviation = std::max(g1Deviation, g2Deviation);
+    if (deviation > tolerance) {
+        std::cerr << "Error: Blur deviation " << deviation << " exceeds tolerance " << tolerance << ".\n";
+        return false;
+    }
+    std::cout << "Compare -> blur deviation within tolerance " << tolerance << "\n";
+    return passed;
+}
+
 // sequential
-void runSeq(FileManager& inputImage, std::string outputPath, float sigma, float k, float p, float epsilon, float phi) {
+bool runSeq(FileManager& inputImage, std::string outputPath, float sigma, float k, float p, float epsilon, float phi,
+            const XDoGOptions& options, bool compare, float tolerance) {
     std::cout << "[Mode: CPU Sequential] Applying XDoG...\n";
     
     Image floatImage = convertToFloatImage(inputImage);
     
-    Image dog = applyXDoG(floatImage, sigma, k, p, epsilon, phi);
+    Image dog = applyXDoG(floatImage, sigma, k, p, epsilon, phi, options);
+    bool withinTolerance = !compare || reportDeviation(floatImage, dog, sigma, k, p, epsilon, phi, options, tolerance);
     
     FileManager outputImage = convertToFMImage(dog);
     
@@ -96,27 +285,226 @@ void runSeq(FileManager& inputImage, std::string outputPath, float sigma, float
         exit(-1);
     }
     std::cout << "Saved: " << outputPath << "/" << outputImage.getFilename() << "\n";
+    return withinTolerance;
 }
 
 // openmp
-void runOMP(FileManager& inputImage, std::string outputPath, float sigma, float k, float p, float epsilon, float phi) {
+bool runOMP(FileManager& inputImage, std::string outputPath, float sigma, float k, float p, float epsilon, float phi,
+            const XDoGOptions& options, bool compare, float tolerance, bool pipeline) {
     std::cout << "[Mode: CPU OpenMP] Applying XDoG on " << omp_get_max_threads() << " threads...\n";
 
-    // 1. Convert to float (Parallel)
-    Image floatImage = convertToFloatImage_OMP(inputImage);
-    
-    // 2. Process (Parallel)
-    Image dog = applyXDoG_OMP(floatImage, sigma, k, p, epsilon, phi);
-    
-    // 3. Convert back (Parallel)
-    FileManager outputImage = convertToFMImage_OMP(dog);
-    
+    FileManager outputImage;
+    bool withinTolerance = true;
+    if (options.tileSize != 0) {
+        // 1-3. Luma, XDoG and 8-bit conversion per cache-resident tile
+        int tile = xdogTileSize_OMP(sigma, k, options);
+        if (tile > 0) std::cout << "Tiled: " << tile << " px tiles\n";
+        else std::cout << "Tiled: not for this blur mode, running plane at a time\n";
+        outputImage = applyXDoGTiled_OMP(inputImage, sigma, k, p, epsilon, phi, options);
+        if (compare) {
+            Image floatImage = convertToFloatImage_OMP(inputImage);
+            withinTolerance = reportDeviation(floatImage, convertToFloatImage_OMP(outputImage), sigma, k, p,
+                                              epsilon, phi, options, tolerance);
+        }
+    } else if (pipeline) {
+        // 1-3. Luma, XDoG and 8-bit conversion in one parallel region
+        outputImage = applyXDoGPipeline_OMP(inputImage, sigma, k, p, epsilon, phi, options);
+        if (compare) {
+            Image floatImage = convertToFloatImage_OMP(inputImage);
+            withinTolerance = reportDeviation(floatImage, convertToFloatImage_OMP(outputImage), sigma, k, p,
+                                              epsilon, phi, options, tolerance);
+        }
+    } else {
+        // 1-2. Convert to luma and process (Parallel); the conversion is fused
+        // into the first blur pass unless a float copy is needed for comparison
+        Image dog = applyXDoG_OMP(inputImage, sigma, k, p, epsilon, phi, options);
+        if (compare) {
+            Image floatImage = convertToFloatImage_OMP(inputImage);
+            withinTolerance = reportDeviation(floatImage, dog, sigma, k, p, epsilon, phi, options, tolerance);
+        }
+
+        // 3. Convert back (Parallel)
+        outputImage = convertToFMImage_OMP(dog);
+    }
+
     outputImage.setFilename("omp_xdog_" + inputImage.getFilename());
     if (!outputImage.saveImage(outputPath)) {
         std::cerr << "Error: Failed to save output image.\n";
         exit(-1);
     }
     std::cout << "Saved: " << outputPath << "/" << outputImage.getFilename() << "\n";
+    return withinTolerance;
+}
+
+// Times the OpenMP pipeline from decoded pixels to 8-bit result, plane at a
+// time, tiled (the --tile size, or auto) and in a single parallel region,
+// best of 'runs' each
+void benchmarkTiling(const FileManager& inputImage, float sigma, float k, float p, float epsilon, float phi,
+                     const XDoGOptions& options, int runs) {
+    XDoGOptions plane = options;
+    plane.tileSize = 0;
+    XDoGOptions tiled = options;
+    if (tiled.tileSize == 0) tiled.tileSize = kTileAuto;
+    int tile = xdogTileSize_OMP(sigma, k, tiled); // 0: tiling would only repeat the plane path
+
+    double planeBest = 1e30;
+    double tiledBest = 1e30;
+    double pipelineBest = 1e30;
+    for (int r = 0; r < runs; ++r) {
+        double t0 = omp_get_wtime();
+        FileManager planeResult = convertToFMImage_OMP(applyXDoG_OMP(inputImage, sigma, k, p, epsilon, phi, plane));
+        double t1 = omp_get_wtime();
+        if (tile > 0) {
+            FileManager tiledResult = applyXDoGTiled_OMP(inputImage, sigma, k, p, epsilon, phi, tiled);
+        }
+        double t2 = omp_get_wtime();
+        FileManager pipelineResult = applyXDoGPipeline_OMP(inputImage, sigma, k, p, epsilon, phi, plane);
+        double t3 = omp_get_wtime();
+        planeBest = std::min(planeBest, t1 - t0);
+        tiledBest = std::min(tiledBest, t2 - t1);
+        pipelineBest = std::min(pipelineBest, t3 - t2);
+    }
+    std::cout << "Benchmark (best of " << runs << ", " << omp_get_max_threads() << " threads):\n"
+              << "  plane-at-a-time: " << planeBest * 1e3 << " ms\n";
+    if (tile > 0) {
+        std::cout << "  tiled (" << tile << " px):    " << tiledBest * 1e3 << " ms (" << planeBest / tiledBest
+                  << "x)\n";
+    }
+    std::cout << "  single region:   " << pipelineBest * 1e3 << " ms (" << planeBest / pipelineBest << "x)\n";
+}
+
+// vector
+bool runVEC(FileManager& inputImage, std::string outputPath, float sigma, float k, float p, float epsilon, float phi,
+            const XDoGOptions& options, bool compare, float tolerance) {
+    std::cout << "[Mode: CPU Vector] Applying XDoG with " << vecISAName(detectVecISA()) << "...\n";
+
+    Image floatImage = convertToFloatImage(inputImage);
+
+    Image dog = applyXDoG_VEC(floatImage, sigma, k, p, epsilon, phi, options);
+    bool withinTolerance = !compare || reportDeviation(floatImage, dog, sigma, k, p, epsilon, phi, options, tolerance);
+
+    FileManager outputImage = convertToFMImage(dog);
+
+    outputImage.setFilename("vec_xdog_" + inputImage.getFilename());
+    if (!outputImage.saveImage(outputPath)) {
+        std::cerr << "Error: Failed to save output image.\n";
+        exit(-1);
+    }
+    std::cout << "Saved: " << outputPath << "/" << outputImage.getFilename() << "\n";
+    return withinTolerance;
+}
+
+// Decoded pixels -> luma rows -> XDoG rows -> 8-bit rows, no float planes.
+// Returns an invalid FileManager on failure.
+FileManager streamXDoGImage(const FileManager& inputImage, float sigma, float k, float p, float epsilon, float phi,
+                            const XDoGOptions& options) {
+    PixelView pixels = inputImage.getPixelView();
+    unsigned char* pBytes = FileManager::allocateImageData(static_cast<size_t>(pixels.width) * pixels.height);
+    if (!pBytes) return FileManager();
+    FileManager outputImage(pBytes, pixels.width, pixels.height, 1, FileManager::AdoptBuffer());
+    PixelRowSource source(pixels);
+    GrayRowSink sink(pBytes, pixels.width, pixels.height);
+    if (!streamXDoG(source, sink, sigma, k, p, epsilon, phi, options.tanhMode)) return FileManager();
+    return outputImage;
+}
+
+// streaming
+void runStream(FileManager& inputImage, std::string outputPath, float sigma, float k, float p, float epsilon, float phi,
+               const XDoGOptions& options) {
+    std::cout << "[Mode: CPU Streaming] Applying XDoG row by row...\n";
+
+    FileManager outputImage = streamXDoGImage(inputImage, sigma, k, p, epsilon, phi, options);
+    if (!outputImage.isValid()) {
+        std::cerr << "Error: Streaming XDoG failed.\n";
+        exit(-1);
+    }
+
+    outputImage.setFilename("stream_xdog_" + inputImage.getFilename());
+    if (!outputImage.saveImage(outputPath)) {
+        std::cerr << "Error: Failed to save output image.\n";
+        exit(-1);
+    }
+    std::cout << "Saved: " << outputPath << "/" << outputImage.getFilename() << "\n";
+}
+
+// thread pool
+bool runPool(FileManager& inputImage, std::string outputPath, float sigma, float k, float p, float epsilon, float phi,
+             const XDoGOptions& options, bool compare, float tolerance, ThreadPool& pool) {
+    std::cout << "[Mode: CPU Thread Pool] Applying XDoG on " << pool.size() << " work-stealing threads...\n";
+
+    // 1-3. Luma, XDoG and 8-bit conversion in pool passes
+    FileManager outputImage = applyXDoG_POOL(inputImage, sigma, k, p, epsilon, phi, pool, options);
+    bool withinTolerance = true;
+    if (compare) {
+        Image floatImage = convertToFloatImage(inputImage);
+        withinTolerance = reportDeviation(floatImage, convertToFloatImage(outputImage), sigma, k, p, epsilon, phi,
+                                          options, tolerance);
+    }
+
+    outputImage.setFilename("pool_xdog_" + inputImage.getFilename());
+    if (!outputImage.saveImage(outputPath)) {
+        std::cerr << "Error: Failed to save output image.\n";
+        exit(-1);
+    }
+    std::cout << "Saved: " << outputPath << "/" << outputImage.getFilename() << "\n";
+    return withinTolerance;
+}
+
+// Times the pool against the OpenMP plane-at-a-time path, decoded pixels to
+// 8-bit result, best of 'runs' each. Both reuse a workspace across runs.
+void benchmarkPool(const FileManager& inputImage, float sigma, float k, float p, float epsilon, float phi,
+                   const XDoGOptions& options, ThreadPool& pool, int runs) {
+    XDoGOptions plane = options;
+    plane.tileSize = 0;
+    XDoGWorkspace poolWorkspace;
+    XDoGWorkspace ompWorkspace;
+
+    double poolBest = 1e30;
+    double ompBest = 1e30;
+    for (int r = 0; r < runs; ++r) {
+        double t0 = omp_get_wtime();
+        FileManager poolResult = applyXDoG_POOL(inputImage, sigma, k, p, epsilon, phi, options, poolWorkspace, pool);
+        double t1 = omp_get_wtime();
+        applyXDoG_OMP(inputImage, ompWorkspace.temp1, sigma, k, p, epsilon, phi, plane, ompWorkspace);
+        FileManager ompResult = convertToFMImage_OMP(ompWorkspace.temp1);
+        double t2 = omp_get_wtime();
+        poolBest = std::min(poolBest, t1 - t0);
+        ompBest = std::min(ompBest, t2 - t1);
+    }
+    std::cout << "Benchmark (best of " << runs << "):\n"
+              << "  OpenMP (" << omp_get_max_threads() << " threads): " << ompBest * 1e3 << " ms\n"
+              << "  pool (" << pool.size() << " threads):   " << poolBest * 1e3 << " ms ("
+              << ompBest / poolBest << "x)\n";
+}
+
+// CPUs this process may run on, in id order
+std::vector<int> allowedCPUs() {
+    std::vector<int> cpus;
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+// gigapixel
+void runGigapixel(const std::string& inputPath, std::string outputPath, float sigma, float k, float p, float epsilon,
+                  float phi, const XDoGOptions& options, size_t budgetBytes) {
+    std::cout << "[Mode: CPU Gigapixel] Applying XDoG tile by tile from disk on " << omp_get_max_threads()
+              << " threads...\n";
+
+    // Same naming as the other modes, as a P5 since tiles are written in place
+    std::string fullPath = outputPath + "giga_xdog_" + std::filesystem::path(inputPath).stem().string() + ".pgm";
+    GigapixelPlan plan;
+    if (!applyXDoGGigapixel(inputPath, fullPath, sigma, k, p, epsilon, phi, options, budgetBytes, &plan)) {
+        std::cerr << "Error: Gigapixel XDoG failed.\n";
+        exit(-1);
+    }
+    std::cout << "Tiles: " << plan.tilesX << " x " << plan.tilesY << " of " << plan.tileWidth << " x "
+              << plan.tileHeight << " px (+" << plan.halo << " px halo), "
+              << plan.tileBytes / (1024.0 * 1024.0) << " MB working set\n";
+    std::cout << "Saved: " << fullPath << "\n";
 }
 
 // cuda
@@ -124,40 +512,287 @@ void runCUDA(FileManager& inputImage, std::string outputPath, float sigma, float
     std::cout << "[Mode: GPU CUDA] Applying XDoG...\n";
 
  
-    FileManager* outputImage = applyXDoG_CUDA(inputImage, sigma, k, p, epsilon, phi);
+    FileManager outputImage = applyXDoG_CUDA(inputImage, sigma, k, p, epsilon, phi);
 
-    if (outputImage == nullptr) {
-        std::cerr << "CUDA Error: Output is null (Check CUDA Memory/Kernel).\n";
+    if (!outputImage.isValid()) {
+        std::cerr << "CUDA Error: Output is invalid (Check CUDA Memory/Kernel).\n";
         return;
     }
 
-    outputImage->setFilename("cuda_xdog_" + inputImage.getFilename());
+    outputImage.setFilename("cuda_xdog_" + inputImage.getFilename());
 
     
-    std::string fullPath = outputPath + "/" + outputImage->getFilename();
+    std::string fullPath = outputPath + "/" + outputImage.getFilename();
 
     if (outputPath.find(".png") != std::string::npos || outputPath.find(".jpg") != std::string::npos) {
         fullPath = outputPath; 
     }
 
-    if (!outputImage->saveImage(fullPath)) {
+    if (!outputImage.saveImage(fullPath)) {
         std::cerr << "Error: Failed to save output image to " << fullPath << "\n";
     } else {
         std::cout << "Saved: " << fullPath << "\n";
     }
+}
+
+// Inputs of a batch: the image files of directory 'source' sorted by name, or
+// the paths listed in file 'source', one per line (blank lines and '#'
+// comments skipped, relative paths taken from the working directory)
+std::vector<std::string> collectBatchInputs(const std::string& source) {
+    std::vector<std::string> inputs;
+    std::error_code error;
+    if (std::filesystem::is_directory(source, error)) {
+        const std::vector<std::string> extensions = { ".png", ".jpg", ".jpeg", ".bmp", ".tga", ".gif",
+                                                      ".psd", ".pgm", ".ppm", ".pnm" };
+        for (const auto& entry : std::filesystem::directory_iterator(source, error)) {
+            if (!entry.is_regular_file(error)) continue;
+            std::string extension = entry.path().extension().string();
+            std::transform(extension.begin(), extension.end(), extension.begin(),
+                           [](unsigned char c) { return std::tolower(c); });
+            if (std::find(extensions.begin(), extensions.end(), extension) != extensions.end()) {
+                inputs.push_back(entry.path().string());
+            }
+        }
+        std::sort(inputs.begin(), inputs.end());
+        return inputs;
+    }
 
-    delete outputImage; 
+    std::ifstream list(source);
+    std::string line;
+    while (std::getline(list, line)) {
+        size_t begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos || line[begin] == '#') continue;
+        size_t end = line.find_last_not_of(" \t\r");
+        inputs.push_back(line.substr(begin, end - begin + 1));
+    }
+    return inputs;
 }
 
+// batch: every input through one backend in this process, as a pipeline of
+// decoder threads, XDoG workers and encoder threads. Each worker keeps its
+// workspaces (float planes, kernels, CUDA buffers) across images, and the
+// pool lives across images too, so only the first image of each size pays
+// for allocation and setup. Returns the number of images that failed to
+// load, process or save.
+int runBatch(const std::vector<std::string>& inputs, std::string outputPath, const std::string& mode, float sigma,
+             float k, float p, float epsilon, float phi, const XDoGOptions& options, bool pipeline,
+             ThreadPool* pool, const BatchPipelineConfig& config) {
+    std::cout << "[Batch] Applying XDoG to " << inputs.size() << " images with " << config.decoders
+              << " decoder(s), " << config.computeWorkers << " XDoG worker(s), " << config.encoders
+              << " encoder(s)...\n";
+
+    std::vector<std::unique_ptr<XDoGWorkspace>> workspaces;
+    std::vector<std::unique_ptr<CUDAWorkspace>> cudaWorkspaces;
+    for (int w = 0; w < config.computeWorkers; ++w) {
+        workspaces.push_back(std::make_unique<XDoGWorkspace>());
+        cudaWorkspaces.push_back(std::make_unique<CUDAWorkspace>());
+    }
+
+    auto process = [&](const FileManager& inputImage, int worker) {
+        XDoGWorkspace& workspace = *workspaces[worker];
+        FileManager outputImage;
+        std::string prefix;
+        if (mode == "1") {
+            outputImage = applyXDoG_CUDA(inputImage, sigma, k, p, epsilon, phi, *cudaWorkspaces[worker]);
+            prefix = "cuda_xdog_";
+        } else if (mode == "2") {
+            if (options.tileSize != 0) {
+                outputImage = applyXDoGTiled_OMP(inputImage, sigma, k, p, epsilon, phi, options, workspace);
+            } else if (pipeline) {
+                outputImage = applyXDoGPipeline_OMP(inputImage, sigma, k, p, epsilon, phi, options, workspace);
+            } else {
+                applyXDoG_OMP(inputImage, workspace.temp1, sigma, k, p, epsilon, phi, options, workspace);
+                outputImage = convertToFMImage_OMP(workspace.temp1);
+            }
+            prefix = "omp_xdog_";
+        } else if (mode == "3") {
+            convertToFloatImage(inputImage, workspace.luma);
+            applyXDoG_VEC(workspace.luma, workspace.temp1, sigma, k, p, epsilon, phi, options, workspace);
+            outputImage = convertToFMImage(workspace.temp1);
+            prefix = "vec_xdog_";
+        } else if (mode == "4") {
+            outputImage = streamXDoGImage(inputImage, sigma, k, p, epsilon, phi, options);
+            prefix = "stream_xdog_";
+        } else if (mode == "6") {
+            outputImage = applyXDoG_POOL(inputImage, sigma, k, p, epsilon, phi, options, workspace, *pool);
+            prefix = "pool_xdog_";
+        } else {
+            convertToFloatImage(inputImage, workspace.luma);
+            applyXDoG(workspace.luma, workspace.temp1, sigma, k, p, epsilon, phi, options, workspace);
+            outputImage = convertToFMImage(workspace.temp1);
+            prefix = "seq_xdog_";
+        }
+        if (!outputImage.isValid()) {
+            std::cerr << "Error: XDoG failed for " << inputImage.getFilename() << "\n";
+        }
+        outputImage.setFilename(prefix + inputImage.getFilename());
+        return outputImage;
+    };
+
+    BatchPipelineStats stats = runBatchPipeline(inputs, outputPath, process, config);
+
+    double wall = stats.wallSeconds;
+    int done = stats.encode.images;
+    std::cout << "Batch: " << done << " of " << inputs.size() << " images, " << stats.megapixels << " MP in "
+              << wall << " s -> " << done / wall << " images/s, " << stats.megapixels / wall << " MP/s\n";
+    auto report = [&](const char* name, const BatchStageStats& stage) {
+        std::cout << "  " << name << stage.threads << " thread(s), busy " << stage.busySeconds << " s, "
+                  << 100.0 * stage.utilisation(wall) << "% utilised\n";
+    };
+    report("decode: ", stats.decode);
+    report("XDoG:   ", stats.compute);
+    report("encode: ", stats.encode);
+    return stats.failed;
+}
 
 int main(int argc, char* argv[]) {
-    // flags[0] = Mode ("0"=Seq, "1"=CUDA, "2"=OMP)
+    // flags[0] = Mode ("0"=Seq, "1"=CUDA, "2"=OMP, "3"=VEC, "4"=Streaming, "5"=Gigapixel, "6"=Pool)
     // flags[2] = Input Path
     // flags[4] = Output Path
     // flags[6] = Shader Path
-    std::string flags[7] = { "0", "0", "", "0", "", "0", "" };
+    // flags[7] = Blur Mode ("direct", "cascade", "iir", "box", "auto", ""=direct, not given)
+    // flags[8] = Compare against direct path ("1"=on)
+    // flags[9] = Quality tier ("exact", "preview", "draft")
+    // flags[10] = Tanh implementation ("libm", "rational")
+    // flags[11] = Tile size in pixels ("0"=off, "auto"=L2-sized), OpenMP only
+    // flags[12] = Benchmark runs ("0"=off), OpenMP and Pool
+    // flags[13] = Memory budget in MB, Gigapixel only
+    // flags[14] = Thread pinning ("none", "sockets", "cores"), OpenMP, Gigapixel and Pool ("cores" only)
+    // flags[15] = Single-region pipeline ("1"=on), OpenMP only
+    // flags[16] = Pool threads ("0"=all CPUs), Pool only
+    // flags[17] = Batch source (directory or list file, ""=single --input)
+    // flags[18] = Batch pipeline threads ("decoders,workers,encoders"), Batch only
+    // flags[19] = Compare tolerance in gray levels (""=per blur mode), Compare only
+    std::string flags[20] = { "0", "0", "", "0", "", "0", "", "", "0", "exact", "libm", "0", "0", "256", "none",
+                              "0", "0", "", "1,1,1", "" };
     getUserInput(argc, argv, flags);
 
+    XDoGOptions options;
+    if (flags[7].empty() || flags[7] == "direct") {
+        options.blurMode = BlurMode::Direct;
+    } else if (flags[7] == "auto") {
+        options.blurMode = BlurMode::Auto;
+    } else if (flags[7] == "cascade") {
+        options.blurMode = BlurMode::Cascaded;
+    } else if (flags[7] == "iir") {
+        options.blurMode = BlurMode::Recursive;
+    } else if (flags[7] == "box") {
+        options.blurMode = BlurMode::Box;
+    } else {
+        std::cerr << "Error: Unknown blur mode: " << flags[7] << "\n";
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    // Lower quality tiers trade blur accuracy for speed with stacked box blurs
+    if ((flags[9] == "preview" || flags[9] == "draft") && !flags[7].empty()) {
+        std::cerr << "Error: --quality " << flags[9] << " picks its own blur, drop --blur " << flags[7] << ".\n";
+        printUsage(argv[0]);
+        return -1;
+    }
+    if (flags[9] == "preview") {
+        options.blurMode = BlurMode::Box;
+        options.boxPasses = 5;
+    } else if (flags[9] == "draft") {
+        options.blurMode = BlurMode::Box;
+        options.boxPasses = 3;
+    } else if (flags[9] != "exact") {
+        std::cerr << "Error: Unknown quality tier: " << flags[9] << "\n";
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    if (flags[10] == "rational") {
+        options.tanhMode = TanhMode::Rational;
+    } else if (flags[10] != "libm") {
+        std::cerr << "Error: Unknown tanh implementation: " << flags[10] << "\n";
+        printUsage(argv[0]);
+        return -1;
+    }
+    // Streaming keeps only kernel-height rings and CUDA has its own kernels:
+    // both run the direct blur only, CUDA with the device tanh
+    if (flags[0] == "1" || flags[0] == "4") {
+        std::string backend = flags[0] == "1" ? "--GPU" : "--stream";
+        if (options.blurMode != BlurMode::Direct) {
+            std::string chosen = flags[9] != "exact" ? "--quality " + flags[9] : "--blur " + flags[7];
+            std::cerr << "Error: " << backend << " supports the direct blur only, not " << chosen << ".\n";
+            return -1;
+        }
+        if (flags[0] == "1" && options.tanhMode != TanhMode::Libm) {
+            std::cerr << "Error: --GPU evaluates tanh on the device, not --tanh " << flags[10] << ".\n";
+            return -1;
+        }
+    }
+    if (flags[11] == "auto") {
+        options.tileSize = kTileAuto;
+    } else {
+        options.tileSize = std::atoi(flags[11].c_str());
+        if (options.tileSize < 0 || (options.tileSize == 0 && flags[11] != "0")) {
+            std::cerr << "Error: Invalid tile size: " << flags[11] << "\n";
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+    ThreadPinning pinning = ThreadPinning::None;
+    if (flags[14] == "sockets") {
+        pinning = ThreadPinning::Sockets;
+    } else if (flags[14] == "cores") {
+        pinning = ThreadPinning::Cores;
+    } else if (flags[14] != "none") {
+        std::cerr << "Error: Unknown pinning mode: " << flags[14] << "\n";
+        printUsage(argv[0]);
+        return -1;
+    }
+    int benchRuns = std::atoi(flags[12].c_str());
+    long long budgetMB = std::atoll(flags[13].c_str());
+    if (budgetMB <= 0) {
+        std::cerr << "Error: Invalid memory budget: " << flags[13] << "\n";
+        printUsage(argv[0]);
+        return -1;
+    }
+    int poolThreads = std::atoi(flags[16].c_str());
+    if (poolThreads < 0 || (poolThreads == 0 && flags[16] != "0")) {
+        std::cerr << "Error: Invalid thread count: " << flags[16] << "\n";
+        printUsage(argv[0]);
+        return -1;
+    }
+    if (flags[0] == "6" && pinning == ThreadPinning::Sockets) {
+        std::cerr << "Error: The pool binds threads per CPU only (--pin cores).\n";
+        return -1;
+    }
+    BatchPipelineConfig batchConfig;
+    {
+        std::stringstream stages(flags[18]);
+        std::string count;
+        std::vector<int> counts;
+        while (std::getline(stages, count, ',')) counts.push_back(std::atoi(count.c_str()));
+        if (counts.size() != 3 || *std::min_element(counts.begin(), counts.end()) < 1) {
+            std::cerr << "Error: Invalid batch stages: " << flags[18] << "\n";
+            printUsage(argv[0]);
+            return -1;
+        }
+        batchConfig.decoders = counts[0];
+        batchConfig.computeWorkers = counts[1];
+        batchConfig.encoders = counts[2];
+    }
+    bool compare = (flags[8] == "1");
+    // Only the single-image runs of these backends hand their result to the comparison
+    if (compare && (flags[0] == "1" || flags[0] == "4" || flags[0] == "5" || !flags[17].empty())) {
+        std::cerr << "Error: --compare needs a single-image sequential, --omp, --vec or --pool run.\n";
+        return -1;
+    }
+
+    float tolerance = -1.0f;
+    if (!flags[19].empty()) {
+        char* end = nullptr;
+        tolerance = std::strtof(flags[19].c_str(), &end);
+        if (*end != '\0' || !(tolerance >= 0.0f)) {
+            std::cerr << "Error: Invalid tolerance: " << flags[19] << "\n";
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+
     // Default Parameters (Tuned for 0-255 range)
     float sigma = 1.0f;
     float k_val = 1.6f;
@@ -177,6 +812,54 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    // Pinning binds this thread too; the batch pipeline's own threads get the CPUs it had before
+    if (pinning != ThreadPinning::None) batchConfig.threadCPUs = allowedCPUs();
+
+    // Before any plane is allocated, so first-touch places rows on the right socket
+    if (pinning != ThreadPinning::None && (flags[0] == "2" || flags[0] == "5")) {
+        int sockets = pinThreads_OMP(pinning);
+        if (sockets > 0) {
+            std::cout << "Pinned " << omp_get_max_threads() << " threads (" << flags[14] << ") across "
+                      << sockets << " socket(s)\n";
+        } else {
+            std::cerr << "Warning: Thread pinning failed, threads left unbound.\n";
+        }
+    }
+
+    // Workers bound round-robin to the usable CPUs with --pin cores
+    std::unique_ptr<ThreadPool> pool;
+    if (flags[0] == "6") {
+        std::vector<int> cpus;
+        if (pinning == ThreadPinning::Cores) cpus = allowedCPUs();
+        pool = std::make_unique<ThreadPool>(poolThreads, cpus);
+        if (!cpus.empty() && !pool->pinned()) std::cerr << "Warning: Thread pinning failed, threads left unbound.\n";
+    }
+
+    if (!flags[17].empty()) {
+        if (flags[0] == "5") {
+            std::cerr << "Error: --batch does not support --gigapixel.\n";
+            return -1;
+        }
+        std::vector<std::string> inputs = collectBatchInputs(flags[17]);
+        if (inputs.empty()) {
+            std::cerr << "Error: No input images found in " << flags[17] << "\n";
+            return -1;
+        }
+        std::cout << "Params -> Sigma:" << sigma << " K:" << k_val
+                  << " p:" << p << " Eps:" << eps << " Phi:" << phi << "\n";
+        int failed = runBatch(inputs, flags[4], flags[0], sigma, k_val, p, eps, phi, options, flags[15] == "1",
+                              pool.get(), batchConfig);
+        return failed == 0 ? 0 : -1;
+    }
+
+    // Gigapixel inputs never fit in memory, tiles are read from the file itself
+    if (flags[0] == "5") {
+        std::cout << "Params -> Sigma:" << sigma << " K:" << k_val
+                  << " p:" << p << " Eps:" << eps << " Phi:" << phi << "\n";
+        runGigapixel(flags[2], flags[4], sigma, k_val, p, eps, phi, options, static_cast<size_t>(budgetMB) << 20);
+        return 0;
+    }
+
     FileManager inputImage(flags[2], "image");
     if (!inputImage.isValid()) {
         std::cerr << "Error: Failed to load input image.\n";
@@ -186,16 +869,30 @@ int main(int argc, char* argv[]) {
     std::cout << "Loaded input: " << inputImage.getFilename() << "\n";
     std::cout << "Params -> Sigma:" << sigma << " K:" << k_val 
               << " p:" << p << " Eps:" << eps << " Phi:" << phi << "\n";
+    if (compare && flags[19].empty()) tolerance = defaultCompareTolerance(options, sigma, k_val);
 
     // Switch based on Mode
     if (flags[0] == "1") {
         runCUDA(inputImage, flags[4], sigma, k_val, p, eps, phi);
     } 
     else if (flags[0] == "2") {
-        runOMP(inputImage, flags[4], sigma, k_val, p, eps, phi);
+        if (benchRuns > 0) benchmarkTiling(inputImage, sigma, k_val, p, eps, phi, options, benchRuns);
+        if (!runOMP(inputImage, flags[4], sigma, k_val, p, eps, phi, options, compare, tolerance, flags[15] == "1")) {
+            return -1;
+        }
     } 
+    else if (flags[0] == "3") {
+        if (!runVEC(inputImage, flags[4], sigma, k_val, p, eps, phi, options, compare, tolerance)) return -1;
+    }
+    else if (flags[0] == "4") {
+        runStream(inputImage, flags[4], sigma, k_val, p, eps, phi, options);
+    }
+    else if (flags[0] == "6") {
+        if (benchRuns > 0) benchmarkPool(inputImage, sigma, k_val, p, eps, phi, options, *pool, benchRuns);
+        if (!runPool(inputImage, flags[4], sigma, k_val, p, eps, phi, options, compare, tolerance, *pool)) return -1;
+    }
     else {
-        runSeq(inputImage, flags[4], sigma, k_val, p, eps, phi);
+        if (!runSeq(inputImage, flags[4], sigma, k_val, p, eps, phi, options, compare, tolerance)) return -1;
     }
 
     return 0;
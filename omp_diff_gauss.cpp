@@ -3,173 +3,663 @@
 #include <algorithm>
 #include <cmath>
 #include <vector>
+#include <utility>
+#include <fstream>
+#include <map>
+#include <string>
+#include <unistd.h>
+#include <sched.h>
 #include <omp.h> 
 
-// Reuse kernel generator
-extern std::vector<float> create1dGaussianKernel(float sigma);
+// Reuse the SIMD row kernels
+extern void convolve_x_row(const float* row, float* out, int w, const float* kernel, int kSize);
+extern void convolve_y_row(const float* const* rows, float* out, int w, const float* kernel, int kSize);
 
-void convolve_x_OMP(const Image& input, Image& output, const std::vector<float>& kernel) {
-    int radius = kernel.size() / 2;
+void convolve_x_OMP(ConstImageView input, ImageView output, const std::vector<float>& kernel) {
     int w = input.width;
     int h = input.height;
     int kSize = kernel.size();
 
-    const float* inData = input.data.data();
-    float* outData = output.data.data();
-
-    // 1. Thread Parallelism (Rows)
-    #pragma omp parallel for
+    // Thread Parallelism (Rows), SIMD inside the row kernel
+    #pragma omp parallel for schedule(static)
     for (int y = 0; y < h; ++y) {
-        int rowOffset = y * w;
-        for (int x = 0; x < w; ++x) {
-            float sum = 0.0f;
-            
-            // 2. SIMD Vectorization (Kernel Calculation)
-            // Reduction handles the summation into a single variable efficiently
-            #pragma omp simd reduction(+:sum)
-            for (int k = 0; k < kSize; ++k) {
-                // Note: std::clamp is usually branchless, fine for SIMD
-                int nx = std::clamp(x + k - radius, 0, w - 1);
-                sum += inData[rowOffset + nx] * kernel[k];
-            }
-            outData[rowOffset + x] = sum;
-        }
+        convolve_x_row(input.row(y), output.row(y), w, kernel.data(), kSize);
     }
 }
 
-void convolve_y_OMP(const Image& input, Image& output, const std::vector<float>& kernel) {
+// Per-thread row-pointer tables come from 'workspace'
+void convolve_y_OMP(ConstImageView input, ImageView output, const std::vector<float>& kernel,
+                    XDoGWorkspace& workspace) {
     int w = input.width;
     int h = input.height;
     int kSize = kernel.size();
     int radius = kSize / 2;
+    workspace.reserveThreads(omp_get_max_threads());
+
+    // Every output row is written exactly once, so no zero-fill pass is needed
+    #pragma omp parallel
+    {
+        std::vector<const float*>& rows = workspace.rowPointers(omp_get_thread_num());
+        if (rows.size() < static_cast<size_t>(kSize)) rows.resize(kSize);
+
+        // Thread Parallelism (Rows), SIMD inside the row kernel
+        #pragma omp for schedule(static)
+        for (int y = 0; y < h; ++y) {
+            for (int k = 0; k < kSize; ++k) {
+                int ny = std::clamp(y + k - radius, 0, h - 1);
+                rows[k] = input.row(ny);
+            }
+            convolve_y_row(rows.data(), output.row(y), w, kernel.data(), kSize);
+        }
+    }
+}
+
+// Sizes a plane for the OpenMP kernels (call outside parallel regions).
+// Fresh storage is zeroed by the threads themselves, each its share of rows
+// in the static partition of the row loops, so under first-touch placement
+// the pages of those rows sit on the NUMA node of the thread that works on
+// them. Task-graph passes take bands in whatever order threads free up;
+// their planes are still spread evenly over the nodes instead of all on
+// the allocating thread's.
+static void resizePlane_OMP(Image& plane, int w, int h) {
+    if (!plane.resizeUntouched(w, h) || plane.stride == 0) return;
+    int rows = plane.data.size() / plane.stride;
+    float* base = plane.data.data();
+    size_t stride = plane.stride;
 
-    // Reset output buffer (Parallel + SIMD)
-    #pragma omp parallel for simd
-    for (size_t i = 0; i < output.data.size(); ++i) {
-        output.data[i] = 0.0f;
+    #pragma omp parallel for schedule(static)
+    for (int r = 0; r < rows; ++r) {
+        std::fill(base + r * stride, base + (r + 1) * stride, 0.0f);
     }
+}
 
-    const float* inData = input.data.data();
-    float* outData = output.data.data();
+// If 'input' already carries a blur of inputSigma, only the residual is applied
+void GaussianBlurRaw_OMP(ConstImageView input, Image& output, Image& tempBuffer, float sigma, float inputSigma,
+                         XDoGWorkspace& workspace) {
+    resizePlane_OMP(tempBuffer, input.width, input.height);
+    resizePlane_OMP(output, input.width, input.height);
 
-    // 1. Thread Parallelism (Rows)
-    #pragma omp parallel for 
-    for (int y = 0; y < h; ++y) {
-        float* destRow = &outData[y * w];
-
-        for (int k = 0; k < kSize; ++k) {
-            int ny = std::clamp(y + k - radius, 0, h - 1);
-            float weight = kernel[k];
-            const float* srcRow = &inData[ny * w];
-
-            // 2. SIMD Vectorization (Pixel addition)
-            // This is the ideal case for SIMD: continuous memory add
-            #pragma omp simd
-            for (int x = 0; x < w; ++x) {
-                destRow[x] += srcRow[x] * weight;
+    if (inputSigma > 0.0f) sigma = cascadeSigma(sigma, inputSigma);
+    const std::vector<float>& kernel = workspace.kernel(sigma);
+
+    convolve_x_OMP(input, tempBuffer, kernel);
+    convolve_y_OMP(tempBuffer, output, kernel, workspace);
+}
+
+// Bands of the task-graph passes: kBlurBlockRows rows, or a kernel radius if taller
+static int bandRows_OMP(int radius) {
+    return std::max(kBlurBlockRows, radius);
+}
+
+// Task dependency key of row band 'b' (clamped to the image) of 'plane'
+static float& bandKey_OMP(Image& plane, int band, int bands, int b) {
+    return plane.row(std::clamp(b, 0, bands - 1) * band)[0];
+}
+
+// Spawns one blur of 'sigma' as tasks of the enclosing parallel region (call
+// from a single construct): the horizontal pass in row blocks, then, once
+// those are done, the vertical pass in column strips (box, recursive) or row
+// bands (direct). The blur selected by 'options' must not be cascaded.
+// Returns at once; the tasks complete by the end of the region. Planes must
+// be input-sized already; kernels are fetched here, so the tasks only touch
+// pixel rows.
+static void spawnBlurTasks_OMP(ConstImageView input, Image& output, Image& tempBuffer, float sigma,
+                               const XDoGOptions& options, XDoGWorkspace& workspace) {
+    int w = input.width;
+    int h = input.height;
+
+    BlurPlan plan = planBlur(sigma, options, workspace);
+    ImageView temp(tempBuffer);
+    ImageView out(output);
+    XDoGWorkspace* ws = &workspace;
+
+    #pragma omp task firstprivate(input, temp, out, ws, plan, w, h)
+    {
+        // Horizontal pass; per-thread scratch is safe, a task runs start to end on one thread
+        #pragma omp taskgroup
+        {
+            for (int block = 0; block < blurRowBlocks(h); ++block) {
+                #pragma omp task firstprivate(block)
+                blurRowBlock(plan, input, temp, block, ws->rowBuffer(omp_get_thread_num()));
+            }
+        }
+
+        // Vertical pass of this blur only; the other blur's tasks keep running meanwhile
+        for (int item = 0; item < blurColumnItems(plan, w, h); ++item) {
+            #pragma omp task firstprivate(item)
+            {
+                int t = omp_get_thread_num();
+                blurColumnItem(plan, temp, out, item, ws->rowBuffer(t), ws->rowPointers(t));
             }
         }
     }
 }
 
-void GaussianBlurRaw_OMP(const Image& input, Image& output, Image& tempBuffer, float sigma) {
+void GaussianBlurMulti_OMP(ConstImageView input, const std::vector<float>& sigmas,
+                           const std::vector<Image*>& outputs, const std::vector<Image*>& tempBuffers,
+                           XDoGWorkspace& workspace) {
     // Resize logic (Single thread safety)
-    if (tempBuffer.width != input.width || tempBuffer.height != input.height) 
-        tempBuffer.resize(input.width, input.height);
-    if (output.width != input.width || output.height != input.height) 
-        output.resize(input.width, input.height);
+    int count = sigmas.size();
+    int w = input.width;
+    int h = input.height;
+    int maxRadius = 0;
+    std::vector<const std::vector<float>*> kernels(count);
+    for (int i = 0; i < count; ++i) {
+        resizePlane_OMP(*tempBuffers[i], w, h);
+        resizePlane_OMP(*outputs[i], w, h);
+        kernels[i] = &workspace.kernel(sigmas[i]);
+        maxRadius = std::max(maxRadius, static_cast<int>(kernels[i]->size() / 2));
+    }
+    int band = bandRows_OMP(maxRadius);
+    int bands = (h + band - 1) / band;
+    workspace.reserveThreads(omp_get_max_threads());
 
-    std::vector<float> kernel = create1dGaussianKernel(sigma);
+    // Task graph over row bands, no barrier between the passes: the vertical
+    // pass of a band (for each blur) runs as soon as the horizontal pass has
+    // produced it and its two neighbours. Dependencies are keyed on the first
+    // row of each band in the first intermediate plane.
+    Image& hKey = *tempBuffers[0];
+    #pragma omp parallel
+    #pragma omp single
+    {
+        // Horizontal pass: each input row is read once and fed to every kernel
+        for (int b = 0; b < bands; ++b) {
+            #pragma omp task firstprivate(b) depend(out: bandKey_OMP(hKey, band, bands, b))
+            {
+                for (int y = b * band; y < std::min((b + 1) * band, h); ++y) {
+                    const float* row = input.row(y);
+                    for (int i = 0; i < count; ++i) {
+                        convolve_x_row(row, tempBuffers[i]->row(y), w, kernels[i]->data(), kernels[i]->size());
+                    }
+                }
+            }
+        }
 
-    convolve_x_OMP(input, tempBuffer, kernel);
-    convolve_y_OMP(tempBuffer, output, kernel);
-}
-
-Image applyXDoG_OMP(const Image& input, float sigma, float k, float p, float epsilon, float phi) {
-    Image g1(input.width, input.height);
-    Image g2(input.width, input.height);
-    Image temp(input.width, input.height); 
-
-    // Parallel Blurs
-    GaussianBlurRaw_OMP(input, g1, temp, sigma);
-    GaussianBlurRaw_OMP(input, g2, temp, sigma * k);
-
-    Image output(input.width, input.height);
-    size_t size = input.data.size();
-
-    const float* pG1 = g1.data.data();
-    const float* pG2 = g2.data.data();
-    float* pOut = output.data.data();
-
-    // Parallel Thresholding with SIMD
-    // Note: tanh might prevent vectorization on older compilers, 
-    // but modern GCC/Clang can vectorize math functions with -O3 -ffast-math
-    #pragma omp parallel for simd 
-    for (size_t i = 0; i < size; ++i) {
-        float scaledDifference = (1.0f + p) * pG1[i] - p * pG2[i];
-        
-        // 0-100 normalization
-        float val = scaledDifference / 255.0f * 100.0f; 
-
-        float result;
-        if (val >= epsilon) {
-            result = 1.0f; 
-        } else {
-            result = 1.0f + std::tanh(phi * (val - epsilon));
+        // Vertical pass: each blur has its own intermediate plane
+        for (int i = 0; i < count; ++i) {
+            for (int b = 0; b < bands; ++b) {
+                #pragma omp task firstprivate(i, b) depend(in: bandKey_OMP(hKey, band, bands, b - 1), \
+                    bandKey_OMP(hKey, band, bands, b), bandKey_OMP(hKey, band, bands, b + 1))
+                {
+                    const std::vector<float>& kernel = *kernels[i];
+                    int kSize = kernel.size();
+                    int radius = kSize / 2;
+                    std::vector<const float*>& rows = workspace.rowPointers(omp_get_thread_num());
+                    if (rows.size() < static_cast<size_t>(kSize)) rows.resize(kSize);
+                    for (int y = b * band; y < std::min((b + 1) * band, h); ++y) {
+                        for (int j = 0; j < kSize; ++j) {
+                            rows[j] = tempBuffers[i]->row(std::clamp(y + j - radius, 0, h - 1));
+                        }
+                        convolve_y_row(rows.data(), outputs[i]->row(y), w, kernel.data(), kSize);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Scratch planes come from 'workspace'
+void GaussianBlurPair_OMP(ConstImageView input, Image& g1, Image& g2, float sigma, float k, const XDoGOptions& options,
+                          XDoGWorkspace& workspace) {
+    Image& temp1 = workspace.temp1;
+    XDoGOptions pair = resolveBlurPair(options, sigma, k);
+    bool recursive1 = useRecursiveBlur(pair, sigma);
+    bool recursive2 = useRecursiveBlur(pair, sigma * k);
+
+    if (options.blurMode == BlurMode::Cascaded && k > 1.0f) {
+        // Parallel Blurs, g2 derived from g1 with the short residual kernel
+        GaussianBlurRaw_OMP(input, g1, temp1, sigma, 0.0f, workspace);
+        GaussianBlurRaw_OMP(g1, g2, temp1, sigma * k, sigma, workspace);
+        fixCascadeBorder(input, g2, temp1, sigma * k, sigma, workspace);
+    } else if (options.blurMode == BlurMode::Box || recursive1 || recursive2) {
+        // Box approximation or large sigmas on the constant-cost recursive
+        // filter. Both blurs form one task graph, each with its own scratch
+        // plane, so their row blocks interleave on all threads and neither
+        // waits at a barrier for the other.
+        Image& temp2 = workspace.temp2;
+        for (Image* plane : {&g1, &g2, &temp1, &temp2}) resizePlane_OMP(*plane, input.width, input.height);
+        workspace.reserveThreads(omp_get_max_threads());
+        #pragma omp parallel
+        #pragma omp single
+        {
+            spawnBlurTasks_OMP(input, g1, temp1, sigma, pair, workspace);
+            spawnBlurTasks_OMP(input, g2, temp2, sigma * k, pair, workspace);
+        }
+    } else {
+        // Parallel Blurs, sharing a single read of the input
+        GaussianBlurMulti_OMP(input, {sigma, sigma * k}, {&g1, &g2}, {&temp1, &workspace.temp2}, workspace);
+    }
+}
+
+// Direct-blur XDoG with the epilogue fused into g2's vertical pass: g2 is
+// never stored, saving a plane of memory plus its write and re-read.
+// The source is either a float plane ('floatInput') or, if that is null,
+// decoded 8-bit pixels converted to luma row by row in the horizontal pass,
+// so no float copy of the input is ever made.
+static void applyXDoGFused_OMP(int w, int h, const ConstImageView* floatInput, const PixelView& pixels, ImageView output,
+                               float sigma, float k, float p, float epsilon, float phi, TanhMode tanhMode,
+                               XDoGWorkspace& workspace) {
+    const std::vector<float>& kernel1 = workspace.kernel(sigma);
+    const std::vector<float>& kernel2 = workspace.kernel(sigma * k);
+    int kSize1 = kernel1.size();
+    int kSize2 = kernel2.size();
+    int radius1 = kSize1 / 2;
+    int radius2 = kSize2 / 2;
+
+    Image& temp1 = workspace.temp1;
+    Image& temp2 = workspace.temp2;
+    Image& g1 = workspace.g1;
+    resizePlane_OMP(temp1, w, h);
+    resizePlane_OMP(temp2, w, h);
+    resizePlane_OMP(g1, w, h);
+    workspace.reserveThreads(omp_get_max_threads());
+    int band = bandRows_OMP(std::max(radius1, radius2));
+    int bands = (h + band - 1) / band;
+
+    // One task graph over row bands instead of three fork/join passes: a
+    // band's g1 rows are blurred as soon as the horizontal pass has produced
+    // it and its neighbours, and its g2 rows (XDoG fused) as soon as g1 has.
+    // Dependencies are keyed on the first row of each band in temp2 (horizontal
+    // pass) and g1 (g1's vertical pass).
+    #pragma omp parallel
+    #pragma omp single
+    {
+        // Horizontal pass: each input row is read once and fed to both kernels
+        for (int b = 0; b < bands; ++b) {
+            #pragma omp task firstprivate(b) depend(out: bandKey_OMP(temp2, band, bands, b))
+            {
+                std::vector<float>& lumaRow = workspace.rowBuffer(omp_get_thread_num());
+                if (!floatInput && lumaRow.size() < static_cast<size_t>(w)) lumaRow.resize(w);
+                for (int y = b * band; y < std::min((b + 1) * band, h); ++y) {
+                    const float* row;
+                    if (floatInput) {
+                        row = floatInput->row(y);
+                    } else {
+                        luma_row(pixels.row(y), lumaRow.data(), w, pixels.channels);
+                        row = lumaRow.data();
+                    }
+                    convolve_x_row(row, temp1.row(y), w, kernel1.data(), kSize1);
+                    convolve_x_row(row, temp2.row(y), w, kernel2.data(), kSize2);
+                }
+            }
+        }
+
+        // Vertical pass of g1
+        for (int b = 0; b < bands; ++b) {
+            #pragma omp task firstprivate(b) depend(in: bandKey_OMP(temp2, band, bands, b - 1), \
+                bandKey_OMP(temp2, band, bands, b), bandKey_OMP(temp2, band, bands, b + 1)) \
+                depend(out: bandKey_OMP(g1, band, bands, b))
+            {
+                std::vector<const float*>& rows = workspace.rowPointers(omp_get_thread_num());
+                if (rows.size() < static_cast<size_t>(kSize1)) rows.resize(kSize1);
+                for (int y = b * band; y < std::min((b + 1) * band, h); ++y) {
+                    for (int j = 0; j < kSize1; ++j) {
+                        rows[j] = temp1.row(std::clamp(y + j - radius1, 0, h - 1));
+                    }
+                    convolve_y_row(rows.data(), g1.row(y), w, kernel1.data(), kSize1);
+                }
+            }
         }
-        
-        // Invert and Scale
-        float finalVal = 255.0f - (result * 255.0f);
 
-        // Clamp
-        if (finalVal < 0.0f) finalVal = 0.0f;
-        if (finalVal > 255.0f) finalVal = 255.0f;
-        
-        pOut[i] = finalVal;
+        // Vertical pass of g2, thresholded against g1 as each row is produced.
+        // 'output' may share temp1's storage, so a band is only written once
+        // g1's pass no longer reads it (the band's and both neighbours' g1 tasks).
+        for (int b = 0; b < bands; ++b) {
+            #pragma omp task firstprivate(b) depend(in: bandKey_OMP(temp2, band, bands, b - 1), \
+                bandKey_OMP(temp2, band, bands, b), bandKey_OMP(temp2, band, bands, b + 1), \
+                bandKey_OMP(g1, band, bands, b - 1), bandKey_OMP(g1, band, bands, b), \
+                bandKey_OMP(g1, band, bands, b + 1))
+            {
+                std::vector<const float*>& rows = workspace.rowPointers(omp_get_thread_num());
+                if (rows.size() < static_cast<size_t>(kSize2)) rows.resize(kSize2);
+                for (int y = b * band; y < std::min((b + 1) * band, h); ++y) {
+                    for (int j = 0; j < kSize2; ++j) {
+                        rows[j] = temp2.row(std::clamp(y + j - radius2, 0, h - 1));
+                    }
+                    convolve_y_xdog_row(rows.data(), g1.row(y), output.row(y), w,
+                                        kernel2.data(), kSize2, p, epsilon, phi, tanhMode);
+                }
+            }
+        }
     }
+}
 
-    return output;
+void applyXDoG_OMP(ConstImageView input, Image& output, float sigma, float k, float p, float epsilon, float phi,
+                   const XDoGOptions& options, XDoGWorkspace& workspace) {
+    // Sized before the blurs, so scratch use of temp1 never reallocates it
+    resizePlane_OMP(output, input.width, input.height);
+    applyXDoG_OMP(input, ImageView(output), sigma, k, p, epsilon, phi, options, workspace);
 }
 
-Image convertToFloatImage_OMP(const FileManager& fm) {
-    int w = fm.getWidth();
-    int h = fm.getHeight();
-    int c = fm.getChannels();
-    std::vector<unsigned char> raw = fm.getImageData();
-    Image img(w, h);
-    size_t size = w * h;
-    const unsigned char* pRaw = raw.data();
-    float* pImg = img.data.data();
-
-    if (c == 1) {
-        #pragma omp parallel for simd
-        for (size_t i = 0; i < size; ++i) {
-            pImg[i] = static_cast<float>(pRaw[i]);
+void applyXDoG_OMP(ConstImageView input, ImageView output, float sigma, float k, float p, float epsilon, float phi,
+                   const XDoGOptions& options, XDoGWorkspace& workspace) {
+    if (useFusedXDoG(sigma, k, options)) {
+        applyXDoGFused_OMP(input.width, input.height, &input, PixelView(), output,
+                           sigma, k, p, epsilon, phi, options.tanhMode, workspace);
+        return;
+    }
+
+    GaussianBlurPair_OMP(input, workspace.g1, workspace.g2, sigma, k, options, workspace);
+
+    const Image& g1 = workspace.g1;
+    const Image& g2 = workspace.g2;
+
+    // Parallel Thresholding: rows across threads, SIMD inside xdog_row
+    int w = input.width;
+    int h = input.height;
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < h; ++y) {
+        xdog_row(g1.row(y), g2.row(y), output.row(y), w, p, epsilon, phi, options.tanhMode);
+    }
+}
+
+void applyXDoG_OMP(const FileManager& fm, Image& output, float sigma, float k, float p, float epsilon, float phi,
+                   const XDoGOptions& options, XDoGWorkspace& workspace) {
+    resizePlane_OMP(output, fm.getWidth(), fm.getHeight());
+    applyXDoG_OMP(fm, ImageView(output), sigma, k, p, epsilon, phi, options, workspace);
+}
+
+void applyXDoG_OMP(const FileManager& fm, ImageView output, float sigma, float k, float p, float epsilon, float phi,
+                   const XDoGOptions& options, XDoGWorkspace& workspace) {
+    PixelView pixels = fm.getPixelView();
+    if (useFusedXDoG(sigma, k, options)) {
+        applyXDoGFused_OMP(pixels.width, pixels.height, nullptr, pixels, output,
+                           sigma, k, p, epsilon, phi, options.tanhMode, workspace);
+        return;
+    }
+    convertToFloatImage_OMP(fm, workspace.luma);
+    applyXDoG_OMP(workspace.luma, output, sigma, k, p, epsilon, phi, options, workspace);
+}
+
+// The by-value forms hand workspace.temp1 out as the result: it is scratch
+// that is dead by the time the result is written, so peak memory stays at
+// three planes on the fused path (temp1, temp2, g1).
+Image applyXDoG_OMP(ConstImageView input, float sigma, float k, float p, float epsilon, float phi,
+                    const XDoGOptions& options) {
+    XDoGWorkspace workspace;
+    applyXDoG_OMP(input, workspace.temp1, sigma, k, p, epsilon, phi, options, workspace);
+    return std::move(workspace.temp1);
+}
+
+Image applyXDoG_OMP(const FileManager& fm, float sigma, float k, float p, float epsilon, float phi,
+                    const XDoGOptions& options) {
+    XDoGWorkspace workspace;
+    applyXDoG_OMP(fm, workspace.temp1, sigma, k, p, epsilon, phi, options, workspace);
+    return std::move(workspace.temp1);
+}
+
+int xdogTileSize_OMP(float sigma, float k, const XDoGOptions& options) {
+    // Recursive and box blurs run plane at a time
+    if (!useFusedXDoG(sigma, k, options)) return 0;
+    if (options.tileSize != kTileAuto) return options.tileSize;
+
+    // The two horizontal-pass planes of a tile plus halo take half of L2,
+    // leaving the rest to the input rows and output stores streaming past
+    long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (l2 <= 0) l2 = 1 << 20;
+    int halo = std::ceil(3.0f * std::max(sigma, sigma * k)); // Radius of the wider kernel
+    int edge = static_cast<int>(std::sqrt(l2 / 2.0 / (2 * sizeof(float))));
+    return std::max((edge - 2 * halo) / 16 * 16, 64);
+}
+
+FileManager applyXDoGTiled_OMP(const FileManager& fm, float sigma, float k, float p, float epsilon, float phi,
+                               const XDoGOptions& options) {
+    XDoGWorkspace workspace;
+    return applyXDoGTiled_OMP(fm, sigma, k, p, epsilon, phi, options, workspace);
+}
+
+FileManager applyXDoGTiled_OMP(const FileManager& fm, float sigma, float k, float p, float epsilon, float phi,
+                               const XDoGOptions& options, XDoGWorkspace& workspace) {
+    int tile = xdogTileSize_OMP(sigma, k, options);
+    if (tile <= 0) {
+        Image& result = workspace.temp1;
+        applyXDoG_OMP(fm, result, sigma, k, p, epsilon, phi, options, workspace);
+        return convertToFMImage_OMP(result);
+    }
+
+    PixelView pixels = fm.getPixelView();
+    int w = pixels.width;
+    int h = pixels.height;
+    const std::vector<float>& kernel1 = workspace.kernel(sigma);
+    const std::vector<float>& kernel2 = workspace.kernel(sigma * k);
+    int kSize1 = kernel1.size();
+    int kSize2 = kernel2.size();
+    int radius1 = kSize1 / 2;
+    int radius2 = kSize2 / 2;
+    int halo = std::max(radius1, radius2);
+    int tilesX = (w + tile - 1) / tile;
+    int tilesY = (h + tile - 1) / tile;
+
+    // Per thread, in its workspace row buffer: both horizontal-pass planes
+    // of a region (tile plus halo), then the luma, g1 and output rows
+    int region = tile + 2 * halo;
+    size_t planeSize = static_cast<size_t>(region) * region;
+    size_t scratchSize = 2 * planeSize + region + 2 * tile;
+    workspace.reserveThreads(omp_get_max_threads());
+
+    unsigned char* pBytes = FileManager::allocateImageData(static_cast<size_t>(w) * h);
+    if (!pBytes) return FileManager();
+
+    #pragma omp parallel
+    {
+        std::vector<float>& scratch = workspace.rowBuffer(omp_get_thread_num());
+        if (scratch.size() < scratchSize) scratch.resize(scratchSize);
+        float* plane1 = scratch.data();
+        float* plane2 = plane1 + planeSize;
+        float* lumaRow = plane2 + planeSize;
+        float* g1Row = lumaRow + region;
+        float* outRow = g1Row + tile;
+        std::vector<const float*>& rows = workspace.rowPointers(omp_get_thread_num());
+        if (rows.size() < static_cast<size_t>(std::max(kSize1, kSize2))) rows.resize(std::max(kSize1, kSize2));
+
+        // Tiles in row-major order, so concurrent tiles share input rows in L3
+        #pragma omp for schedule(dynamic)
+        for (int t = 0; t < tilesX * tilesY; ++t) {
+            int tx0 = (t % tilesX) * tile;
+            int ty0 = (t / tilesX) * tile;
+            int tw = std::min(tile, w - tx0);
+            int th = std::min(tile, h - ty0);
+
+            // Tile plus halo, clipped to the image where the kernels clamp anyway.
+            // Every tap of a tile pixel lies inside, halo outputs are discarded.
+            int rx0 = std::max(tx0 - halo, 0);
+            int ry0 = std::max(ty0 - halo, 0);
+            int rw = std::min(tx0 + tw + halo, w) - rx0;
+            int rh = std::min(ty0 + th + halo, h) - ry0;
+            ImageView temp1(plane1, rw, rh, rw);
+            ImageView temp2(plane2, rw, rh, rw);
+
+            // Luma and both horizontal passes, one region row at a time
+            for (int y = 0; y < rh; ++y) {
+                const unsigned char* src = pixels.row(ry0 + y) + static_cast<size_t>(rx0) * pixels.channels;
+                luma_row(src, lumaRow, rw, pixels.channels);
+                convolve_x_row(lumaRow, temp1.row(y), rw, kernel1.data(), kSize1);
+                convolve_x_row(lumaRow, temp2.row(y), rw, kernel2.data(), kSize2);
+            }
+
+            // Vertical passes over the tile's own pixels, XDoG fused into g2's,
+            // then straight to the 8-bit result
+            int ox = tx0 - rx0;
+            for (int y = ty0; y < ty0 + th; ++y) {
+                int ly = y - ry0;
+                for (int j = 0; j < kSize1; ++j) {
+                    rows[j] = temp1.row(std::clamp(ly + j - radius1, 0, rh - 1)) + ox;
+                }
+                convolve_y_row(rows.data(), g1Row, tw, kernel1.data(), kSize1);
+                for (int j = 0; j < kSize2; ++j) {
+                    rows[j] = temp2.row(std::clamp(ly + j - radius2, 0, rh - 1)) + ox;
+                }
+                convolve_y_xdog_row(rows.data(), g1Row, outRow, tw,
+                                    kernel2.data(), kSize2, p, epsilon, phi, options.tanhMode);
+                quantize_row(outRow, &pBytes[static_cast<size_t>(y) * w + tx0], tw);
+            }
+        }
+    }
+    return FileManager(pBytes, w, h, 1, FileManager::AdoptBuffer());
+}
+
+FileManager applyXDoGPipeline_OMP(const FileManager& fm, float sigma, float k, float p, float epsilon, float phi,
+                                  const XDoGOptions& options, XDoGWorkspace& workspace) {
+    if (!useFusedXDoG(sigma, k, options)) {
+        // Recursive, box and cascaded blurs run plane at a time
+        Image& result = workspace.temp1;
+        applyXDoG_OMP(fm, result, sigma, k, p, epsilon, phi, options, workspace);
+        return convertToFMImage_OMP(result);
+    }
+
+    PixelView pixels = fm.getPixelView();
+    int w = pixels.width;
+    int h = pixels.height;
+    const std::vector<float>& kernel1 = workspace.kernel(sigma);
+    const std::vector<float>& kernel2 = workspace.kernel(sigma * k);
+    int kSize1 = kernel1.size();
+    int kSize2 = kernel2.size();
+    int radius1 = kSize1 / 2;
+    int radius2 = kSize2 / 2;
+    int band = bandRows_OMP(std::max(radius1, radius2));
+    int bands = (h + band - 1) / band;
+
+    Image& temp1 = workspace.temp1;
+    Image& temp2 = workspace.temp2;
+    resizePlane_OMP(temp1, w, h);
+    resizePlane_OMP(temp2, w, h);
+    workspace.reserveThreads(omp_get_max_threads());
+    std::vector<int>& ready = workspace.bandFlags;
+    ready.assign(bands, 0);
+
+    unsigned char* pBytes = FileManager::allocateImageData(static_cast<size_t>(w) * h);
+    if (!pBytes) return FileManager();
+
+    #pragma omp parallel
+    {
+        std::vector<float>& scratch = workspace.rowBuffer(omp_get_thread_num());
+        if (scratch.size() < 3 * static_cast<size_t>(w)) scratch.resize(3 * static_cast<size_t>(w));
+        float* lumaRow = scratch.data();
+        float* g1Row = lumaRow + w;
+        float* outRow = g1Row + w;
+        std::vector<const float*>& rows = workspace.rowPointers(omp_get_thread_num());
+        if (rows.size() < static_cast<size_t>(std::max(kSize1, kSize2))) rows.resize(std::max(kSize1, kSize2));
+
+        // Luma and both horizontal passes. A thread moves on as soon as its
+        // own bands are done and flags each one for its neighbours.
+        #pragma omp for schedule(static) nowait
+        for (int b = 0; b < bands; ++b) {
+            for (int y = b * band; y < std::min((b + 1) * band, h); ++y) {
+                luma_row(pixels.row(y), lumaRow, w, pixels.channels);
+                convolve_x_row(lumaRow, temp1.row(y), w, kernel1.data(), kSize1);
+                convolve_x_row(lumaRow, temp2.row(y), w, kernel2.data(), kSize2);
+            }
+            #pragma omp atomic write seq_cst
+            ready[b] = 1;
         }
-    } 
-    else if (c >= 3) {
-        #pragma omp parallel for simd
-        for (size_t i = 0; i < size; ++i) {
-            int idx = i * c;
-            // RGB to Grayscale
-            pImg[i] = 0.299f * pRaw[idx] + 0.587f * pRaw[idx+1] + 0.114f * pRaw[idx+2];
+
+        // Vertical passes, XDoG and 8-bit conversion, row by row. Same static
+        // partition, so each thread gets the bands it filled itself; only the
+        // halo rows of the two neighbouring bands are waited for.
+        #pragma omp for schedule(static) nowait
+        for (int b = 0; b < bands; ++b) {
+            for (int nb = std::max(b - 1, 0); nb <= std::min(b + 1, bands - 1); ++nb) {
+                int done;
+                #pragma omp atomic read seq_cst
+                done = ready[nb];
+                while (!done) {
+                    sched_yield();
+                    #pragma omp atomic read seq_cst
+                    done = ready[nb];
+                }
+            }
+
+            for (int y = b * band; y < std::min((b + 1) * band, h); ++y) {
+                for (int j = 0; j < kSize1; ++j) {
+                    rows[j] = temp1.row(std::clamp(y + j - radius1, 0, h - 1));
+                }
+                convolve_y_row(rows.data(), g1Row, w, kernel1.data(), kSize1);
+                for (int j = 0; j < kSize2; ++j) {
+                    rows[j] = temp2.row(std::clamp(y + j - radius2, 0, h - 1));
+                }
+                convolve_y_xdog_row(rows.data(), g1Row, outRow, w, kernel2.data(), kSize2,
+                                    p, epsilon, phi, options.tanhMode);
+                quantize_row(outRow, &pBytes[static_cast<size_t>(y) * w], w);
+            }
         }
     }
-    return img;
+    return FileManager(pBytes, w, h, 1, FileManager::AdoptBuffer());
+}
+
+FileManager applyXDoGPipeline_OMP(const FileManager& fm, float sigma, float k, float p, float epsilon, float phi,
+                                  const XDoGOptions& options) {
+    XDoGWorkspace workspace;
+    return applyXDoGPipeline_OMP(fm, sigma, k, p, epsilon, phi, options, workspace);
+}
+
+int pinThreads_OMP(ThreadPinning mode) {
+    if (mode == ThreadPinning::None) return 0;
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return 0;
+
+    // Usable CPUs by socket; without topology information they form one socket
+    std::map<int, std::vector<int>> sockets;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, &allowed)) continue;
+        std::ifstream package("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/physical_package_id");
+        int socket = 0;
+        if (!(package >> socket)) socket = 0;
+        sockets[socket].push_back(cpu);
+    }
+    if (sockets.empty()) return 0;
+
+    std::vector<std::vector<int>> groups;
+    std::vector<int> cpus; // Socket by socket
+    for (const auto& socket : sockets) {
+        groups.push_back(socket.second);
+        cpus.insert(cpus.end(), socket.second.begin(), socket.second.end());
+    }
+
+    int threads = omp_get_max_threads();
+    int failures = 0;
+    #pragma omp parallel num_threads(threads) reduction(+ : failures)
+    {
+        size_t t = omp_get_thread_num();
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (mode == ThreadPinning::Sockets) {
+            for (int cpu : groups[t * groups.size() / threads]) CPU_SET(cpu, &set);
+        } else {
+            CPU_SET(cpus[t * cpus.size() / threads], &set);
+        }
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) ++failures;
+    }
+    return failures == 0 ? static_cast<int>(std::min<size_t>(groups.size(), threads)) : 0;
+}
+
+void convertToFloatImage_OMP(const FileManager& fm, Image& img) {
+    PixelView pixels = fm.getPixelView();
+    int w = pixels.width;
+    int h = pixels.height;
+    resizePlane_OMP(img, w, h);
+
+    // Rows across threads, SIMD inside luma_row
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < h; ++y) {
+        luma_row(pixels.row(y), img.row(y), w, pixels.channels);
+    }
 }
 
-FileManager convertToFMImage_OMP(const Image& img) {
-    std::vector<unsigned char> bytes(img.width * img.height);
-    size_t size = img.data.size();
-    const float* pData = img.data.data();
-    unsigned char* pBytes = bytes.data();
+Image convertToFloatImage_OMP(const FileManager& fm) {
+    Image img(0, 0);
+    convertToFloatImage_OMP(fm, img);
+    return img;
+}
+FileManager convertToFMImage_OMP(ConstImageView img) {
+    // Quantize straight into the buffer the FileManager adopts, no extra copy
+    int w = img.width;
+    int h = img.height;
+    unsigned char* pBytes = FileManager::allocateImageData(static_cast<size_t>(w) * h);
+    if (!pBytes) return FileManager();
 
-    #pragma omp parallel for simd
-    for (size_t i = 0; i < size; ++i) {
-        float val = pData[i];
-        if (val < 0.0f) val = 0.0f;
-        else if (val > 255.0f) val = 255.0f;
-        pBytes[i] = static_cast<unsigned char>(val);
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < h; ++y) {
+        quantize_row(img.row(y), &pBytes[static_cast<size_t>(y) * w], w);
     }
-    return FileManager(bytes.data(), img.width, img.height, 1);
+    return FileManager(pBytes, img.width, img.height, 1, FileManager::AdoptBuffer());
 }
\ No newline at end of file
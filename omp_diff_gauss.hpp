@@ -9,9 +9,69 @@
 // If you want to run this standalone, copy the struct definition here.
 
 // Function declarations with _OMP suffix to avoid linker collisions
-Image applyXDoG_OMP(const Image& input, float sigma, float k, float p, float epsilon, float phi);
+Image applyXDoG_OMP(ConstImageView input, float sigma, float k, float p, float epsilon, float phi,
+                    const XDoGOptions& options = XDoGOptions());
+
+// Same, straight from the decoded 8-bit pixels: on the fused path luma is
+// computed inside the first horizontal pass, no float copy of the input is made.
+Image applyXDoG_OMP(const FileManager& fm, float sigma, float k, float p, float epsilon, float phi,
+                    const XDoGOptions& options = XDoGOptions());
+
+// Allocation-free forms for repeated calls: 'output' is resized as needed and
+// all intermediates live in 'workspace'. 'output' may be workspace.temp1.
+void applyXDoG_OMP(ConstImageView input, Image& output, float sigma, float k, float p, float epsilon, float phi,
+                   const XDoGOptions& options, XDoGWorkspace& workspace);
+void applyXDoG_OMP(const FileManager& fm, Image& output, float sigma, float k, float p, float epsilon, float phi,
+                   const XDoGOptions& options, XDoGWorkspace& workspace);
+// Same, writing into an input-sized view (see applyXDoG)
+void applyXDoG_OMP(ConstImageView input, ImageView output, float sigma, float k, float p, float epsilon, float phi,
+                   const XDoGOptions& options, XDoGWorkspace& workspace);
+void applyXDoG_OMP(const FileManager& fm, ImageView output, float sigma, float k, float p, float epsilon, float phi,
+                   const XDoGOptions& options, XDoGWorkspace& workspace);
+
+// Cache-blocked XDoG, from the decoded pixels to the 8-bit result. The image
+// is cut into square tiles (options.tileSize, kTileAuto = sized to L2) that
+// each go luma -> blur x -> blur y -> XDoG -> quantize while cache-resident,
+// reading a halo of the larger kernel's radius around them, so the result
+// is the plane-at-a-time direct one up to float rounding. Blur modes other
+// than direct, and tileSize 0, run plane at a time.
+FileManager applyXDoGTiled_OMP(const FileManager& fm, float sigma, float k, float p, float epsilon, float phi,
+                               const XDoGOptions& options);
+// Same, with kernels and per-thread tile planes kept in 'workspace' between calls
+FileManager applyXDoGTiled_OMP(const FileManager& fm, float sigma, float k, float p, float epsilon, float phi,
+                               const XDoGOptions& options, XDoGWorkspace& workspace);
+// Direct-blur XDoG from the decoded pixels to the 8-bit result in a single
+// parallel region: luma and the horizontal passes, then per row both vertical
+// passes, XDoG and quantization, with no g1/g2 planes. Both loops share one
+// static partition of row bands and run 'nowait'; a band waits only for the
+// horizontal pass of its two neighbours (its halo rows), not for a barrier.
+// Same result as applyXDoG_OMP. Other blur modes run plane at a time.
+FileManager applyXDoGPipeline_OMP(const FileManager& fm, float sigma, float k, float p, float epsilon, float phi,
+                                  const XDoGOptions& options, XDoGWorkspace& workspace);
+FileManager applyXDoGPipeline_OMP(const FileManager& fm, float sigma, float k, float p, float epsilon, float phi,
+                                  const XDoGOptions& options = XDoGOptions());
+
+// Tile edge applyXDoGTiled_OMP uses for these parameters, 0 if it runs
+// plane at a time instead
+int xdogTileSize_OMP(float sigma, float k, const XDoGOptions& options);
+
+// Thread placement for the OpenMP backend on multi-socket machines
+enum class ThreadPinning {
+    None,    // Left to the OS (or to OMP_PROC_BIND / OMP_PLACES)
+    Sockets, // Each thread bound to all CPUs of one socket
+    Cores    // Each thread bound to one CPU
+};
+
+// Binds the omp_get_max_threads() OpenMP threads so that consecutive thread
+// numbers share a socket: thread t goes to socket t * sockets / threads.
+// That matches the static row partition, so the rows a thread first-touches
+// are in its own socket's memory. Sockets are read from sysfs, within the
+// CPUs this process may use. Binding lasts for later parallel regions of the
+// same size. Returns the number of sockets used, 0 if nothing was bound.
+int pinThreads_OMP(ThreadPinning mode);
 
 Image convertToFloatImage_OMP(const FileManager& fm);
-FileManager convertToFMImage_OMP(const Image& img);
+void convertToFloatImage_OMP(const FileManager& fm, Image& img);
+FileManager convertToFMImage_OMP(ConstImageView img);
 
 #endif
\ No newline at end of file
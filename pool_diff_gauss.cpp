@@ -0,0 +1,309 @@
+#include "pool_diff_gauss.hpp"
+#include <algorithm>
+#include <pthread.h>
+#include <sched.h>
+
+// Reuse the SIMD row kernels
+extern void convolve_x_row(const float* row, float* out, int w, const float* kernel, int kSize);
+extern void convolve_y_row(const float* const* rows, float* out, int w, const float* kernel, int kSize);
+
+// Failed steal rounds after which a worker goes back to sleep. Ranges are
+// split as soon as they are taken, so late work to steal is rare.
+const int kIdleSpinsPOOL = 64;
+
+ThreadPool::ThreadPool(int threads, const std::vector<int>& cpus) {
+    if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int t = 0; t < threads; ++t) queues.push_back(std::make_unique<Queue>());
+    for (int t = 1; t < threads; ++t) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, t);
+        if (cpus.empty()) continue;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus[(t - 1) % cpus.size()], &set);
+        if (pthread_setaffinity_np(workers.back().native_handle(), sizeof(set), &set) != 0) pinOk = false;
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(sleepLock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) worker.join();
+}
+
+// Newest range of the own deque, else the oldest of the next non-empty one
+bool ThreadPool::popOrSteal(int self, Range& range) {
+    {
+        Queue& own = *queues[self];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.ranges.empty()) {
+            range = own.ranges.back();
+            own.ranges.pop_back();
+            return true;
+        }
+    }
+    int count = size();
+    for (int d = 1; d < count; ++d) {
+        Queue& victim = *queues[(self + d) % count];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.ranges.empty()) {
+            range = victim.ranges.front();
+            victim.ranges.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::runOne(int self) {
+    Range range;
+    if (!popOrSteal(self, range)) return false;
+
+    // Halve down to one index, leaving the upper halves to be stolen. The
+    // owner pops them back smallest first, so it still walks up the range.
+    {
+        Queue& own = *queues[self];
+        std::lock_guard<std::mutex> guard(own.lock);
+        while (range.end - range.begin > 1) {
+            int mid = range.begin + (range.end - range.begin) / 2;
+            own.ranges.push_back({mid, range.end});
+            range.end = mid;
+        }
+    }
+    (*job)(range.begin, self);
+
+    if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::lock_guard<std::mutex> guard(sleepLock);
+        finished.notify_all();
+    }
+    return true;
+}
+
+void ThreadPool::workerLoop(int self) {
+    unsigned seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(sleepLock);
+            wake.wait(guard, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+        int idle = 0;
+        while (pending.load(std::memory_order_acquire) > 0) {
+            if (runOne(self)) {
+                idle = 0;
+            } else if (++idle < kIdleSpinsPOOL) {
+                std::this_thread::yield();
+            } else {
+                break;
+            }
+        }
+    }
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int, int)>& body) {
+    if (count <= 0) return;
+    std::lock_guard<std::mutex> call(callLock);
+    int threads = size();
+    if (threads == 1) {
+        for (int i = 0; i < count; ++i) body(i, 0);
+        return;
+    }
+
+    // Set before any range is visible: a range is taken under its deque's lock
+    job = &body;
+    pending.store(count, std::memory_order_release);
+    // One contiguous share per thread, the static partition stealing starts from
+    for (int t = 0; t < threads; ++t) {
+        int begin = static_cast<long long>(count) * t / threads;
+        int end = static_cast<long long>(count) * (t + 1) / threads;
+        if (begin == end) continue;
+        Queue& queue = *queues[t];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        queue.ranges.push_back({begin, end});
+    }
+    {
+        std::lock_guard<std::mutex> guard(sleepLock);
+        ++generation;
+    }
+    wake.notify_all();
+
+    // The caller works as thread 0, then waits for indices still running elsewhere
+    while (pending.load(std::memory_order_acquire) > 0) {
+        if (runOne(0)) continue;
+        std::unique_lock<std::mutex> guard(sleepLock);
+        finished.wait(guard, [&] { return pending.load(std::memory_order_acquire) == 0; });
+    }
+    job = nullptr;
+}
+
+// Both blurs, one horizontal and one vertical pool pass each, so the
+// blocks of the two blurs share the threads; a blur given no 'second' runs alone
+static void blurPasses_POOL(ConstImageView input, const BlurPlan& first, Image& out1, Image& temp1,
+                            const BlurPlan* second, Image* out2, Image* temp2, XDoGWorkspace& workspace,
+                            ThreadPool& pool) {
+    int w = input.width;
+    int h = input.height;
+    out1.resize(w, h);
+    temp1.resize(w, h);
+    if (second) {
+        out2->resize(w, h);
+        temp2->resize(w, h);
+    }
+    workspace.reserveThreads(pool.size());
+
+    int rowBlocks = blurRowBlocks(h);
+    pool.parallelFor(second ? 2 * rowBlocks : rowBlocks, [&](int i, int t) {
+        if (i < rowBlocks) blurRowBlock(first, input, temp1, i, workspace.rowBuffer(t));
+        else blurRowBlock(*second, input, *temp2, i - rowBlocks, workspace.rowBuffer(t));
+    });
+
+    int items1 = blurColumnItems(first, w, h);
+    int items2 = second ? blurColumnItems(*second, w, h) : 0;
+    pool.parallelFor(items1 + items2, [&](int i, int t) {
+        if (i < items1) {
+            blurColumnItem(first, temp1, out1, i, workspace.rowBuffer(t), workspace.rowPointers(t));
+        } else {
+            blurColumnItem(*second, *temp2, *out2, i - items1, workspace.rowBuffer(t), workspace.rowPointers(t));
+        }
+    });
+}
+
+// Direct-blur XDoG in two passes over row bands: luma (if the source is
+// 'pixels', floatInput null) and both horizontal passes into g1/temp2, then
+// per row g1's vertical pass into scratch and g2's with the XDoG fused. The
+// result goes to 'output' or, if that is null, quantized into 'bytes'.
+// temp1 is not used, so 'output' may share its storage.
+static void applyXDoGFused_POOL(int w, int h, const ConstImageView* floatInput, const PixelView& pixels,
+                                const ImageView* output, unsigned char* bytes, float sigma, float k, float p,
+                                float epsilon, float phi, TanhMode tanhMode, XDoGWorkspace& workspace,
+                                ThreadPool& pool) {
+    const std::vector<float>& kernel1 = workspace.kernel(sigma);
+    const std::vector<float>& kernel2 = workspace.kernel(sigma * k);
+    int kSize1 = kernel1.size();
+    int kSize2 = kernel2.size();
+    int radius1 = kSize1 / 2;
+    int radius2 = kSize2 / 2;
+    int band = std::max(kBlurBlockRows, std::max(radius1, radius2));
+    int bands = (h + band - 1) / band;
+
+    Image& hPass1 = workspace.g1;
+    Image& hPass2 = workspace.temp2;
+    hPass1.resize(w, h);
+    hPass2.resize(w, h);
+    workspace.reserveThreads(pool.size());
+
+    pool.parallelFor(bands, [&](int b, int t) {
+        std::vector<float>& lumaRow = workspace.rowBuffer(t);
+        if (!floatInput && lumaRow.size() < static_cast<size_t>(w)) lumaRow.resize(w);
+        for (int y = b * band; y < std::min((b + 1) * band, h); ++y) {
+            const float* row;
+            if (floatInput) {
+                row = floatInput->row(y);
+            } else {
+                luma_row(pixels.row(y), lumaRow.data(), w, pixels.channels);
+                row = lumaRow.data();
+            }
+            convolve_x_row(row, hPass1.row(y), w, kernel1.data(), kSize1);
+            convolve_x_row(row, hPass2.row(y), w, kernel2.data(), kSize2);
+        }
+    });
+
+    pool.parallelFor(bands, [&](int b, int t) {
+        std::vector<float>& scratch = workspace.rowBuffer(t);
+        if (scratch.size() < 2 * static_cast<size_t>(w)) scratch.resize(2 * static_cast<size_t>(w));
+        float* g1Row = scratch.data();
+        float* outRow = g1Row + w;
+        std::vector<const float*>& rows = workspace.rowPointers(t);
+        if (rows.size() < static_cast<size_t>(std::max(kSize1, kSize2))) rows.resize(std::max(kSize1, kSize2));
+        for (int y = b * band; y < std::min((b + 1) * band, h); ++y) {
+            for (int j = 0; j < kSize1; ++j) {
+                rows[j] = hPass1.row(std::clamp(y + j - radius1, 0, h - 1));
+            }
+            convolve_y_row(rows.data(), g1Row, w, kernel1.data(), kSize1);
+            for (int j = 0; j < kSize2; ++j) {
+                rows[j] = hPass2.row(std::clamp(y + j - radius2, 0, h - 1));
+            }
+            float* out = output ? output->row(y) : outRow;
+            convolve_y_xdog_row(rows.data(), g1Row, out, w, kernel2.data(), kSize2, p, epsilon, phi, tanhMode);
+            if (!output) quantize_row(out, &bytes[static_cast<size_t>(y) * w], w);
+        }
+    });
+}
+
+// Any blur mode, plane at a time: g1 and g2, then the XDoG per row block into
+// 'output' or, if that is null, quantized into 'bytes'
+static void applyXDoGPlanes_POOL(ConstImageView input, const ImageView* output, unsigned char* bytes, float sigma,
+                                 float k, float p, float epsilon, float phi, const XDoGOptions& options,
+                                 XDoGWorkspace& workspace, ThreadPool& pool) {
+    Image& g1 = workspace.g1;
+    Image& g2 = workspace.g2;
+    if (options.blurMode == BlurMode::Cascaded && k > 1.0f) {
+        // g2 derived from g1 with the short residual kernel
+        BlurPlan pass1 = planDirectBlur(sigma, workspace);
+        BlurPlan residual = planDirectBlur(cascadeSigma(sigma * k, sigma), workspace);
+        blurPasses_POOL(input, pass1, g1, workspace.temp1, nullptr, nullptr, nullptr, workspace, pool);
+        blurPasses_POOL(g1, residual, g2, workspace.temp1, nullptr, nullptr, nullptr, workspace, pool);
+        fixCascadeBorder(input, g2, workspace.temp1, sigma * k, sigma, workspace);
+    } else {
+        XDoGOptions pair = resolveBlurPair(options, sigma, k);
+        BlurPlan pass1 = planBlur(sigma, pair, workspace);
+        BlurPlan pass2 = planBlur(sigma * k, pair, workspace);
+        blurPasses_POOL(input, pass1, g1, workspace.temp1, &pass2, &g2, &workspace.temp2, workspace, pool);
+    }
+
+    int w = input.width;
+    int h = input.height;
+    pool.parallelFor(blurRowBlocks(h), [&](int b, int t) {
+        std::vector<float>& outRow = workspace.rowBuffer(t);
+        if (!output && outRow.size() < static_cast<size_t>(w)) outRow.resize(w);
+        for (int y = b * kBlurBlockRows; y < std::min((b + 1) * kBlurBlockRows, h); ++y) {
+            float* out = output ? output->row(y) : outRow.data();
+            xdog_row(g1.row(y), g2.row(y), out, w, p, epsilon, phi, options.tanhMode);
+            if (!output) quantize_row(out, &bytes[static_cast<size_t>(y) * w], w);
+        }
+    });
+}
+
+void applyXDoG_POOL(ConstImageView input, ImageView output, float sigma, float k, float p, float epsilon, float phi,
+                    const XDoGOptions& options, XDoGWorkspace& workspace, ThreadPool& pool) {
+    if (useFusedXDoG(sigma, k, options)) {
+        applyXDoGFused_POOL(input.width, input.height, &input, PixelView(), &output, nullptr,
+                            sigma, k, p, epsilon, phi, options.tanhMode, workspace, pool);
+    } else {
+        applyXDoGPlanes_POOL(input, &output, nullptr, sigma, k, p, epsilon, phi, options, workspace, pool);
+    }
+}
+
+FileManager applyXDoG_POOL(const FileManager& fm, float sigma, float k, float p, float epsilon, float phi,
+                           const XDoGOptions& options, XDoGWorkspace& workspace, ThreadPool& pool) {
+    PixelView pixels = fm.getPixelView();
+    int w = pixels.width;
+    int h = pixels.height;
+    unsigned char* pBytes = FileManager::allocateImageData(static_cast<size_t>(w) * h);
+    if (!pBytes) return FileManager();
+
+    if (useFusedXDoG(sigma, k, options)) {
+        applyXDoGFused_POOL(w, h, nullptr, pixels, nullptr, pBytes,
+                            sigma, k, p, epsilon, phi, options.tanhMode, workspace, pool);
+    } else {
+        // The plane-at-a-time blurs need a float copy of the input
+        Image& luma = workspace.luma;
+        luma.resize(w, h);
+        pool.parallelFor(blurRowBlocks(h), [&](int b, int) {
+            for (int y = b * kBlurBlockRows; y < std::min((b + 1) * kBlurBlockRows, h); ++y) {
+                luma_row(pixels.row(y), luma.row(y), w, pixels.channels);
+            }
+        });
+        applyXDoGPlanes_POOL(luma, nullptr, pBytes, sigma, k, p, epsilon, phi, options, workspace, pool);
+    }
+    return FileManager(pBytes, w, h, 1, FileManager::AdoptBuffer());
+}
+
+FileManager applyXDoG_POOL(const FileManager& fm, float sigma, float k, float p, float epsilon, float phi,
+                           ThreadPool& pool, const XDoGOptions& options) {
+    XDoGWorkspace workspace;
+    return applyXDoG_POOL(fm, sigma, k, p, epsilon, phi, options, workspace, pool);
+}
@@ -0,0 +1,90 @@
+#ifndef POOL_DIFF_GAUSS_H
+#define POOL_DIFF_GAUSS_H
+
+#include "seq_diff_gauss.hpp" // Image, views, XDoGWorkspace, row kernels
+#include "file_manager.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Backend on a built-in work-stealing thread pool instead of the OpenMP
+// runtime, for hosts that embed the filter next to their own threads (no
+// global team, no OMP_* environment, thread count and placement chosen by
+// the caller per pool).
+
+// Fixed set of worker threads with one task deque each. parallelFor() deals
+// an index range out as one contiguous share per deque; a thread takes the
+// newest entry of its own deque, splitting large ranges in half and pushing
+// the upper half back, and when it runs dry steals the oldest (largest)
+// entry of another deque. Idle workers sleep on a condition variable.
+class ThreadPool {
+public:
+    // 'threads' includes the calling thread, which works inside parallelFor
+    // (0 = std::thread::hardware_concurrency()). Worker i (1..threads-1) is
+    // bound to CPU cpus[(i - 1) % cpus.size()] if 'cpus' is not empty; the
+    // caller's own affinity is left alone.
+    explicit ThreadPool(int threads = 0, const std::vector<int>& cpus = std::vector<int>());
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Threads taking part in parallelFor, the caller included
+    int size() const { return static_cast<int>(queues.size()); }
+    // false if binding a worker to its CPU failed
+    bool pinned() const { return pinOk; }
+
+    // Calls body(i, thread) for every i in [0, count) and returns once all
+    // calls are done. 'thread' (0..size()-1) is unique among the calls running
+    // at the same time, for indexing per-thread scratch. Calls from several
+    // threads at once are serialised; 'body' must not call parallelFor.
+    void parallelFor(int count, const std::function<void(int, int)>& body);
+
+private:
+    struct Range {
+        int begin;
+        int end;
+    };
+    struct Queue {
+        std::mutex lock;
+        std::deque<Range> ranges;
+    };
+
+    bool popOrSteal(int self, Range& range);
+    bool runOne(int self);
+    void workerLoop(int self);
+
+    std::vector<std::unique_ptr<Queue>> queues; // Index 0 is the calling thread
+    std::vector<std::thread> workers;
+    std::mutex callLock;  // One parallelFor at a time
+    std::mutex sleepLock; // Guards generation and stopping, pairs with the condition variables
+    std::condition_variable wake;
+    std::condition_variable finished;
+    unsigned generation = 0;
+    bool stopping = false;
+    bool pinOk = true;
+    const std::function<void(int, int)>* job = nullptr;
+    std::atomic<int> pending{0}; // Indices of the current call not yet done
+};
+
+// XDoG of a float plane into an input-sized view on 'pool'. Direct blurs run
+// as two passes over row bands, the second doing both vertical passes and
+// the XDoG per row (no g1/g2 planes); box and recursive blurs split their
+// horizontal passes into row blocks and vertical passes into column strips,
+// both blurs in the same pass. Same kernels, hence the same result, as
+// applyXDoG_OMP. 'output' may be workspace.temp1.
+void applyXDoG_POOL(ConstImageView input, ImageView output, float sigma, float k, float p, float epsilon, float phi,
+                    const XDoGOptions& options, XDoGWorkspace& workspace, ThreadPool& pool);
+
+// Same, from the decoded pixels to the 8-bit result (luma computed in the
+// first pass, quantization in the last)
+FileManager applyXDoG_POOL(const FileManager& fm, float sigma, float k, float p, float epsilon, float phi,
+                           const XDoGOptions& options, XDoGWorkspace& workspace, ThreadPool& pool);
+FileManager applyXDoG_POOL(const FileManager& fm, float sigma, float k, float p, float epsilon, float phi,
+                           ThreadPool& pool, const XDoGOptions& options = XDoGOptions());
+
+#endif
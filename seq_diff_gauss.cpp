@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <cmath>
 #include <vector>
+#include <complex>
 
 // ... (Kernels and Convolutions remain exactly the same as you have them) ...
 // ... Copy paste your previous create1dGaussianKernel, convolve_x, convolve_y, GaussianBlurRaw ...
@@ -25,128 +26,893 @@ std::vector<float> create1dGaussianKernel(float sigma) {
     return kernel;
 }
 
-void convolve_x(const Image& input, Image& output, const std::vector<float>& kernel) {
-    int radius = kernel.size() / 2;
+const std::vector<float>& XDoGWorkspace::kernel(float sigma) {
+    for (const auto& entry : kernels) {
+        if (entry.first == sigma) return entry.second;
+    }
+    // deque: growing never moves the kernels handed out earlier
+    kernels.emplace_back(sigma, create1dGaussianKernel(sigma));
+    return kernels.back().second;
+}
+
+const IIRCoefficients& XDoGWorkspace::iirCoefficients(float sigma) {
+    for (const auto& entry : iirCoefficientSets) {
+        if (entry.first == sigma) return entry.second;
+    }
+    iirCoefficientSets.emplace_back(sigma, computeIIRCoefficients(sigma));
+    return iirCoefficientSets.back().second;
+}
+
+const std::vector<int>& XDoGWorkspace::boxRadii(float sigma, int passes) {
+    for (const auto& entry : boxRadiiSets) {
+        if (entry.sigma == sigma && entry.passes == passes) return entry.radii;
+    }
+    boxRadiiSets.push_back({sigma, passes, boxRadiiForGauss(sigma, passes)});
+    return boxRadiiSets.back().radii;
+}
+
+void Image::extendBorder() {
+    if (halo == 0 || width == 0 || height == 0) return;
+    for (int y = 0; y < height; ++y) {
+        float* r = row(y);
+        std::fill(r - halo, r, r[0]);
+        std::fill(r + width, r + width + halo, r[width - 1]);
+    }
+    for (int i = 1; i <= halo; ++i) {
+        std::copy(row(0) - halo, row(0) + width + halo, row(-i) - halo);
+        std::copy(row(height - 1) - halo, row(height - 1) + width + halo, row(height - 1 + i) - halo);
+    }
+}
+
+void XDoGWorkspace::reserveThreads(int count) {
+    if (rowBuffers.size() < static_cast<size_t>(count)) {
+        rowBuffers.resize(count);
+        rowPointerTables.resize(count);
+    }
+}
+
+// Number of adjacent output pixels computed together by the horizontal pass
+const int kBlockX = 32;
+
+// Horizontal pass over one row. Outputs are produced in blocks of kBlockX
+// adjacent pixels: each tap broadcasts one weight over a contiguous run of
+// inputs, so SIMD runs across pixels instead of reducing over taps.
+// Only the first/last 'radius' pixels need clamping.
+// 'omp simd' is only a vectorization hint here, this stays single-threaded;
+// the OpenMP backend reuses these row kernels inside its parallel loops.
+void convolve_x_row(const float* row, float* out, int w, const float* kernel, int kSize) {
+    int radius = kSize / 2;
+    int begin = std::min(radius, w);
+    int end = std::max(begin, w - radius);
+
+    // Left border (clamped)
+    for (int x = 0; x < begin; ++x) {
+        float sum = 0.0f;
+        for (int k = 0; k < kSize; ++k) {
+            int nx = std::clamp(x + k - radius, 0, w - 1);
+            sum += row[nx] * kernel[k];
+        }
+        out[x] = sum;
+    }
+
+    // Interior, no clamping
+    int x = begin;
+    for (; x + kBlockX <= end; x += kBlockX) {
+        float acc[kBlockX] = {};
+        const float* src = row + x - radius;
+        for (int k = 0; k < kSize; ++k) {
+            float weight = kernel[k];
+            #pragma omp simd
+            for (int j = 0; j < kBlockX; ++j) {
+                acc[j] += src[k + j] * weight;
+            }
+        }
+        #pragma omp simd
+        for (int j = 0; j < kBlockX; ++j) {
+            out[x + j] = acc[j];
+        }
+    }
+    for (; x < end; ++x) {
+        const float* src = row + x - radius;
+        float sum = 0.0f;
+        for (int k = 0; k < kSize; ++k) {
+            sum += src[k] * kernel[k];
+        }
+        out[x] = sum;
+    }
+
+    // Right border (clamped)
+    for (x = end; x < w; ++x) {
+        float sum = 0.0f;
+        for (int k = 0; k < kSize; ++k) {
+            int nx = std::clamp(x + k - radius, 0, w - 1);
+            sum += row[nx] * kernel[k];
+        }
+        out[x] = sum;
+    }
+}
+
+void convolve_x(ConstImageView input, ImageView output, const std::vector<float>& kernel) {
     int w = input.width;
     int h = input.height;
     int kSize = kernel.size();
-    const float* inData = input.data.data();
-    float* outData = output.data.data();
     for (int y = 0; y < h; ++y) {
-        int rowOffset = y * w;
-        for (int x = 0; x < w; ++x) {
-            float sum = 0.0f;
-            for (int k = 0; k < kSize; ++k) {
-                int nx = std::clamp(x + k - radius, 0, w - 1);
-                sum += inData[rowOffset + nx] * kernel[k];
+        convolve_x_row(input.row(y), output.row(y), w, kernel.data(), kSize);
+    }
+}
+
+// Number of adjacent columns whose accumulators stay in registers during the vertical pass
+const int kStripY = 32;
+
+// Vertical pass for one output row. rows[k] is the (already clamped) source
+// row for tap k. A strip of kStripY columns is accumulated over all taps in
+// registers and then stored once, so the destination is never re-read.
+void convolve_y_row(const float* const* rows, float* out, int w, const float* kernel, int kSize) {
+    int x = 0;
+    for (; x + kStripY <= w; x += kStripY) {
+        float acc[kStripY] = {};
+        for (int k = 0; k < kSize; ++k) {
+            float weight = kernel[k];
+            const float* src = rows[k] + x;
+            #pragma omp simd
+            for (int j = 0; j < kStripY; ++j) {
+                acc[j] += src[j] * weight;
             }
-            outData[rowOffset + x] = sum;
         }
+        #pragma omp simd
+        for (int j = 0; j < kStripY; ++j) {
+            out[x + j] = acc[j];
+        }
+    }
+    for (; x < w; ++x) {
+        float sum = 0.0f;
+        for (int k = 0; k < kSize; ++k) {
+            sum += rows[k][x] * kernel[k];
+        }
+        out[x] = sum;
     }
 }
 
-void convolve_y(const Image& input, Image& output, const std::vector<float>& kernel) {
+void xdog_row(const float* g1, const float* g2, float* out, int n,
+              float p, float epsilon, float phi, TanhMode tanhMode) {
+    if (tanhMode == TanhMode::Rational) {
+        #pragma omp simd
+        for (int i = 0; i < n; ++i) {
+            out[i] = xdogThreshold(g1[i], g2[i], p, epsilon, phi, TanhMode::Rational);
+        }
+    } else {
+        #pragma omp simd
+        for (int i = 0; i < n; ++i) {
+            out[i] = xdogThreshold(g1[i], g2[i], p, epsilon, phi, TanhMode::Libm);
+        }
+    }
+}
+
+void convolve_y_xdog_row(const float* const* rows, const float* g1Row, float* out, int w,
+                         const float* kernel, int kSize, float p, float epsilon, float phi,
+                         TanhMode tanhMode) {
+    int x = 0;
+    for (; x + kStripY <= w; x += kStripY) {
+        float acc[kStripY] = {};
+        for (int k = 0; k < kSize; ++k) {
+            float weight = kernel[k];
+            const float* src = rows[k] + x;
+            #pragma omp simd
+            for (int j = 0; j < kStripY; ++j) {
+                acc[j] += src[j] * weight;
+            }
+        }
+        xdog_row(&g1Row[x], acc, &out[x], kStripY, p, epsilon, phi, tanhMode);
+    }
+    for (; x < w; ++x) {
+        float sum = 0.0f;
+        for (int k = 0; k < kSize; ++k) {
+            sum += rows[k][x] * kernel[k];
+        }
+        xdog_row(&g1Row[x], &sum, &out[x], 1, p, epsilon, phi, tanhMode);
+    }
+}
+
+// 'rows' is scratch for the per-tap row pointers, grown as needed
+void convolve_y(ConstImageView input, ImageView output, const std::vector<float>& kernel,
+                std::vector<const float*>& rows) {
     int w = input.width;
     int h = input.height;
     int kSize = kernel.size();
     int radius = kSize / 2;
-    std::fill(output.data.begin(), output.data.end(), 0.0f);
-    const float* inData = input.data.data();
-    float* outData = output.data.data();
+    if (rows.size() < static_cast<size_t>(kSize)) rows.resize(kSize);
     for (int y = 0; y < h; ++y) {
-        float* destRow = &outData[y * w];
         for (int k = 0; k < kSize; ++k) {
             int ny = std::clamp(y + k - radius, 0, h - 1);
-            float weight = kernel[k];
-            const float* srcRow = &inData[ny * w];
-            for (int x = 0; x < w; ++x) {
-                destRow[x] += srcRow[x] * weight;
-            }
+            rows[k] = input.row(ny);
         }
+        convolve_y_row(rows.data(), output.row(y), w, kernel.data(), kSize);
     }
 }
 
-void GaussianBlurRaw(const Image& input, Image& output, Image& tempBuffer, float sigma) {
+void convolve_y(ConstImageView input, ImageView output, const std::vector<float>& kernel) {
+    std::vector<const float*> rows;
+    convolve_y(input, output, kernel, rows);
+}
+
+float cascadeSigma(float targetSigma, float inputSigma) {
+    return std::sqrt(targetSigma * targetSigma - inputSigma * inputSigma);
+}
+
+void GaussianBlurRaw(ConstImageView input, Image& output, Image& tempBuffer, float sigma, float inputSigma) {
+    XDoGWorkspace workspace;
+    GaussianBlurRaw(input, output, tempBuffer, sigma, inputSigma, workspace);
+}
+
+void GaussianBlurRaw(ConstImageView input, Image& output, Image& tempBuffer, float sigma, float inputSigma,
+                     XDoGWorkspace& workspace) {
     if (tempBuffer.width != input.width || tempBuffer.height != input.height) 
         tempBuffer.resize(input.width, input.height);
     if (output.width != input.width || output.height != input.height) 
         output.resize(input.width, input.height);
-    std::vector<float> kernel = create1dGaussianKernel(sigma);
+    if (inputSigma > 0.0f) sigma = cascadeSigma(sigma, inputSigma);
+    const std::vector<float>& kernel = workspace.kernel(sigma);
     convolve_x(input, tempBuffer, kernel);
-    convolve_y(tempBuffer, output, kernel);
+    convolve_y(tempBuffer, output, kernel, workspace.rowPointers(0));
 }
 
-// ... (applyDoG remains the same) ...
+// Clamp-to-edge borders do not commute with cascading: within the residual
+// kernel's radius of an edge, the second blur replicates *blurred* pixels
+// instead of input pixels. Everywhere else the cascade equals the direct blur
+// up to kernel truncation, so only that band is recomputed from 'input'.
+void fixCascadeBorder(ConstImageView input, Image& output, Image& tempBuffer, float sigma, float inputSigma) {
+    XDoGWorkspace workspace;
+    fixCascadeBorder(input, output, tempBuffer, sigma, inputSigma, workspace);
+}
+
+void fixCascadeBorder(ConstImageView input, Image& output, Image& tempBuffer, float sigma, float inputSigma,
+                      XDoGWorkspace& workspace) {
+    int w = input.width;
+    int h = input.height;
+    int band = std::ceil(3.0f * cascadeSigma(sigma, inputSigma)); // Residual kernel radius
+    const std::vector<float>& kernel = workspace.kernel(sigma);
+    int kSize = kernel.size();
+    int radius = kSize / 2;
+
+    int left = std::min(band, w);
+    int right = std::max(left, w - band);
+    int top = std::min(band, h);
+    int bottom = std::max(top, h - band);
+
+    // Direct horizontal pass: full rows within the vertical kernel's reach of
+    // the top/bottom band, only the left/right band columns elsewhere.
+    int fullTop = std::min(top + radius, h);
+    int fullBottom = std::max(fullTop, bottom - radius);
+    for (int y = 0; y < h; ++y) {
+        const float* row = input.row(y);
+        float* tmpRow = tempBuffer.row(y);
+        if (y < fullTop || y >= fullBottom) {
+            convolve_x_row(row, tmpRow, w, kernel.data(), kSize);
+            continue;
+        }
+        for (int x = 0; x < w; ++x) {
+            if (x == left) x = right;
+            if (x >= w) break;
+            float sum = 0.0f;
+            for (int k = 0; k < kSize; ++k) {
+                int nx = std::clamp(x + k - radius, 0, w - 1);
+                sum += row[nx] * kernel[k];
+            }
+            tmpRow[x] = sum;
+        }
+    }
+
+    // Direct vertical pass on the border band only
+    std::vector<const float*>& rows = workspace.rowPointers(0);
+    if (rows.size() < static_cast<size_t>(kSize)) rows.resize(kSize);
+    for (int y = 0; y < h; ++y) {
+        for (int k = 0; k < kSize; ++k) {
+            int ny = std::clamp(y + k - radius, 0, h - 1);
+            rows[k] = tempBuffer.row(ny);
+        }
+        float* outRow = output.row(y);
+        if (y < top || y >= bottom) {
+            convolve_y_row(rows.data(), outRow, w, kernel.data(), kSize);
+            continue;
+        }
+        for (int x = 0; x < w; ++x) {
+            if (x == left) x = right;
+            if (x >= w) break;
+            float sum = 0.0f;
+            for (int k = 0; k < kSize; ++k) {
+                sum += rows[k][x] * kernel[k];
+            }
+            outRow[x] = sum;
+        }
+    }
+}
+
+bool useRecursiveBlur(const XDoGOptions& options, float sigma) {
+    // A third-order recursion cannot follow very narrow Gaussians
+    if (sigma < 0.5f) return false;
+    if (options.blurMode == BlurMode::Recursive) return true;
+    return options.blurMode == BlurMode::Auto && sigma >= kRecursiveSigmaThreshold;
+}
+
+XDoGOptions resolveBlurPair(const XDoGOptions& options, float sigma, float k) {
+    XDoGOptions resolved = options;
+    if (options.blurMode == BlurMode::Auto) {
+        bool recursive = std::min(sigma, sigma * k) >= kRecursiveSigmaThreshold;
+        resolved.blurMode = recursive ? BlurMode::Recursive : BlurMode::Direct;
+    }
+    return resolved;
+}
+
+bool useFusedXDoG(float sigma, float k, const XDoGOptions& options) {
+    BlurMode mode = resolveBlurPair(options, sigma, k).blurMode;
+    return mode == BlurMode::Direct || (mode == BlurMode::Cascaded && k <= 1.0f);
+}
+
+// Variance of the causal + anti-causal filter with these poles (|d| > 1)
+static double iirVariance(const std::complex<double>* poles, int count) {
+    std::complex<double> sum = 0.0;
+    for (int i = 0; i < count; ++i) {
+        sum += poles[i] / ((poles[i] - 1.0) * (poles[i] - 1.0));
+    }
+    return 2.0 * sum.real();
+}
+
+IIRCoefficients computeIIRCoefficients(float sigma) {
+    // Third-order pole set optimised for sigma0 = 2 (Young, van Vliet and
+    // van Ginkel, 2002). Raising the poles to the power 1/q rescales the
+    // filter; q is chosen so that the variance is exactly sigma^2, which is
+    // far more accurate than the original 1995 closed-form fit for q.
+    const std::complex<double> basePoles[3] = {
+        {1.41650, 1.00829}, {1.41650, -1.00829}, {1.86543, 0.0}
+    };
+    std::complex<double> poles[3];
+    double target = static_cast<double>(sigma) * sigma;
+    double lo = 0.01;
+    double hi = 1000.0;
+    for (int iter = 0; iter < 100; ++iter) {
+        double q = 0.5 * (lo + hi);
+        for (int i = 0; i < 3; ++i) poles[i] = std::pow(basePoles[i], 1.0 / q);
+        // Variance grows with q
+        if (iirVariance(poles, 3) < target) lo = q;
+        else hi = q;
+    }
+
+    // Expand (1 - z^-1 / d1)(1 - z^-1 / d2)(1 - z^-1 / d3), d2 = conj(d1)
+    std::complex<double> r1 = 1.0 / poles[0];
+    double r3 = (1.0 / poles[2]).real();
+    double re = r1.real();
+    double mag2 = std::norm(r1);
+
+    IIRCoefficients c;
+    c.a1 = static_cast<float>(2.0 * re + r3);
+    c.a2 = static_cast<float>(-(mag2 + 2.0 * re * r3));
+    c.a3 = static_cast<float>(mag2 * r3);
+    c.B = 1.0f - (c.a1 + c.a2 + c.a3);
+    // Run past the edge until the slowest pole has decayed below 1e-4
+    double slowest = std::max(std::abs(r1), r3);
+    c.pad = static_cast<int>(std::ceil(std::log(1e-4) / std::log(slowest)));
+    return c;
+}
+
+// Horizontal recursive pass over up to kIIRRows rows. The rows are transposed
+// into 'buffer' so that the recursion along x runs SIMD across the rows.
+// Layout per x: kIIRRows floats, with 3 leading slots (left edge state), then
+// w samples, c.pad samples of right edge extension and 3 trailing slots.
+void iir_x_rows(const float* const* inRows, float* const* outRows, int count, int w,
+                const IIRCoefficients& c, float* buffer) {
+    const int R = kIIRRows;
+    int length = w + c.pad;
+    float* line = buffer + 3 * R;
+
+    for (int r = 0; r < R; ++r) {
+        const float* in = inRows[r < count ? r : 0];
+        for (int i = -3; i < 0; ++i) line[i * R + r] = in[0];
+        for (int x = 0; x < w; ++x) line[x * R + r] = in[x];
+        for (int x = w; x < length + 3; ++x) line[x * R + r] = in[w - 1];
+    }
+
+    // Causal pass, left edge in steady state
+    for (int i = 0; i < length; ++i) {
+        float* cur = line + i * R;
+        #pragma omp simd
+        for (int r = 0; r < R; ++r) {
+            cur[r] = c.B * cur[r] + c.a1 * cur[r - R] + c.a2 * cur[r - 2 * R] + c.a3 * cur[r - 3 * R];
+        }
+    }
+
+    // Anti-causal pass, started past the padding where the right edge is in steady state
+    for (int i = length - 1; i >= 0; --i) {
+        float* cur = line + i * R;
+        #pragma omp simd
+        for (int r = 0; r < R; ++r) {
+            cur[r] = c.B * cur[r] + c.a1 * cur[r + R] + c.a2 * cur[r + 2 * R] + c.a3 * cur[r + 3 * R];
+        }
+    }
+
+    for (int r = 0; r < count; ++r) {
+        float* out = outRows[r];
+        for (int x = 0; x < w; ++x) out[x] = line[x * R + r];
+    }
+}
 
-Image applyXDoG(const Image& input, float sigma, float k, float p, float epsilon, float phi) {
-    Image g1(input.width, input.height);
-    Image g2(input.width, input.height);
-    Image temp(input.width, input.height); 
+// Vertical recursive pass over columns [x0, x1) for the full height, SIMD
+// across columns. The forward result is kept in 'output' itself, only the
+// 3 leading edge rows and the bottom extension live in 'edgeBuffer'.
+void iir_y_columns(ConstImageView input, ImageView output, int x0, int x1,
+                   const IIRCoefficients& c, std::vector<float>& edgeBuffer) {
+    int h = input.height;
+    int n = x1 - x0;
+    int length = h + c.pad;
+    edgeBuffer.resize(static_cast<size_t>(c.pad + 6) * n);
+    float* lead = edgeBuffer.data();        // rows -3..-1
+    float* tail = lead + 3 * n;             // rows h..h+pad+2
+
+    auto rowAt = [&](int i) -> float* {
+        if (i < 0) return lead + (i + 3) * n;
+        if (i < h) return output.row(i) + x0;
+        return tail + static_cast<size_t>(i - h) * n;
+    };
 
-    GaussianBlurRaw(input, g1, temp, sigma);
-    GaussianBlurRaw(input, g2, temp, sigma * k);
+    const float* firstRow = input.row(0) + x0;
+    const float* lastRow = input.row(h - 1) + x0;
+    for (int i = -3; i < 0; ++i) std::copy(firstRow, firstRow + n, rowAt(i));
+    for (int i = length; i < length + 3; ++i) std::copy(lastRow, lastRow + n, rowAt(i));
+
+    // Causal pass
+    for (int i = 0; i < length; ++i) {
+        const float* src = i < h ? input.row(i) + x0 : lastRow;
+        float* cur = rowAt(i);
+        const float* p1 = rowAt(i - 1);
+        const float* p2 = rowAt(i - 2);
+        const float* p3 = rowAt(i - 3);
+        #pragma omp simd
+        for (int j = 0; j < n; ++j) {
+            cur[j] = c.B * src[j] + c.a1 * p1[j] + c.a2 * p2[j] + c.a3 * p3[j];
+        }
+    }
 
-    Image output(input.width, input.height);
-    size_t size = input.data.size();
+    // Anti-causal pass
+    for (int i = length - 1; i >= 0; --i) {
+        float* cur = rowAt(i);
+        const float* n1 = rowAt(i + 1);
+        const float* n2 = rowAt(i + 2);
+        const float* n3 = rowAt(i + 3);
+        #pragma omp simd
+        for (int j = 0; j < n; ++j) {
+            cur[j] = c.B * cur[j] + c.a1 * n1[j] + c.a2 * n2[j] + c.a3 * n3[j];
+        }
+    }
+}
 
-    const float* pG1 = g1.data.data();
-    const float* pG2 = g2.data.data();
-    float* pOut = output.data.data();
+void GaussianBlurIIR(ConstImageView input, Image& output, Image& tempBuffer, float sigma) {
+    XDoGWorkspace workspace;
+    GaussianBlurIIR(input, output, tempBuffer, sigma, workspace);
+}
 
-    for (size_t i = 0; i < size; ++i) {
-        float scaledDifference = (1.0f + p) * pG1[i] - p * pG2[i];
-        float val = scaledDifference / 255.0f * 100.0f; 
+void GaussianBlurIIR(ConstImageView input, Image& output, Image& tempBuffer, float sigma,
+                     XDoGWorkspace& workspace) {
+    int w = input.width;
+    int h = input.height;
+    if (tempBuffer.width != w || tempBuffer.height != h) 
+        tempBuffer.resize(w, h);
+    if (output.width != w || output.height != h) 
+        output.resize(w, h);
+    const IIRCoefficients& c = workspace.iirCoefficients(sigma);
 
-        float result;
-        if (val >= epsilon) {
-            result = 1.0f; 
-        } else {
-            result = 1.0f + std::tanh(phi * (val - epsilon));
+    // One scratch buffer serves both passes: line buffer, then edge rows
+    std::vector<float>& buffer = workspace.rowBuffer(0);
+    buffer.resize(std::max(buffer.size(), static_cast<size_t>(w + c.pad + 6) * kIIRRows));
+    const float* inRows[kIIRRows];
+    float* outRows[kIIRRows];
+    for (int y0 = 0; y0 < h; y0 += kIIRRows) {
+        int count = std::min(kIIRRows, h - y0);
+        for (int r = 0; r < count; ++r) {
+            inRows[r] = input.row(y0 + r);
+            outRows[r] = tempBuffer.row(y0 + r);
         }
-        
-        // --- CHANGE HERE ---
-        // Invert the result to get "Black lines on White Background"
-        // Original: pOut[i] = result * 255.0f;
-        pOut[i] = 255.0f - (result * 255.0f);
+        iir_x_rows(inRows, outRows, count, w, c, buffer.data());
+    }
+
+    iir_y_columns(tempBuffer, output, 0, w, c, buffer);
+}
+
+std::vector<int> boxRadiiForGauss(float sigma, int passes) {
+    // Widths w_l and w_u = w_l + 2 (both odd), m passes of w_l and the rest
+    // of w_u, chosen so that the summed variance (w^2 - 1) / 12 is sigma^2
+    float ideal = std::sqrt(12.0f * sigma * sigma / passes + 1.0f);
+    int wl = std::floor(ideal);
+    if (wl % 2 == 0) wl--;
+    int wu = wl + 2;
+    float mIdeal = (12.0f * sigma * sigma - passes * wl * wl - 4.0f * passes * wl - 3.0f * passes) / (-4.0f * wl - 4.0f);
+    int m = std::round(mIdeal);
+
+    std::vector<int> radii(passes);
+    for (int i = 0; i < passes; ++i) {
+        radii[i] = ((i < m ? wl : wu) - 1) / 2;
+    }
+    return radii;
+}
 
-        if (pOut[i] < 0.0f) pOut[i] = 0.0f;
-        if (pOut[i] > 255.0f) pOut[i] = 255.0f;
+// Horizontal box passes over up to kBoxRows rows. As in iir_x_rows the rows
+// are transposed into 'buffer' (2 * w * kBoxRows floats, ping-ponged between
+// passes) so each running sum advances SIMD across the rows instead of
+// waiting on its own serial add chain.
+void box_x_rows(const float* const* inRows, float* const* outRows, int count, int w,
+                const std::vector<int>& radii, float* buffer) {
+    const int R = kBoxRows;
+    float* src = buffer;
+    float* dst = buffer + static_cast<size_t>(w) * R;
+
+    // Transposes go through R x R tiles to stay within L1
+    for (int x0 = 0; x0 < w; x0 += R) {
+        int x1 = std::min(x0 + R, w);
+        for (int r = 0; r < R; ++r) {
+            const float* in = inRows[r < count ? r : 0];
+            for (int x = x0; x < x1; ++x) src[x * R + r] = in[x];
+        }
     }
 
-    return output;
+    for (int radius : radii) {
+        float norm = 1.0f / (2 * radius + 1);
+        float acc[R] = {};
+        // Running sum of the clamped window around x = 0
+        for (int k = -radius; k <= radius; ++k) {
+            const float* in = src + std::clamp(k, 0, w - 1) * R;
+            #pragma omp simd
+            for (int r = 0; r < R; ++r) acc[r] += in[r];
+        }
+        for (int x = 0; x < w; ++x) {
+            const float* enter = src + std::min(x + radius + 1, w - 1) * R;
+            const float* leave = src + std::max(x - radius, 0) * R;
+            float* out = dst + x * R;
+            #pragma omp simd
+            for (int r = 0; r < R; ++r) {
+                out[r] = acc[r] * norm;
+                acc[r] += enter[r] - leave[r];
+            }
+        }
+        std::swap(src, dst);
+    }
+
+    for (int x0 = 0; x0 < w; x0 += R) {
+        int x1 = std::min(x0 + R, w);
+        for (int r = 0; r < count; ++r) {
+            float* out = outRows[r];
+            for (int x = x0; x < x1; ++x) out[x] = src[x * R + r];
+        }
+    }
+}
+
+// All vertical box passes for columns [x0, x1), streamed down the image.
+// Pass i runs (r_i + 1) rows behind pass i - 1, which therefore only has to
+// keep its last 2 * r_i + 2 rows in a ring inside 'rings', so
+// the intermediates stay in cache and the image is read and written once.
+void box_y_columns(ConstImageView input, ImageView output, int x0, int x1,
+                   const std::vector<int>& radii, std::vector<float>& rings) {
+    int h = input.height;
+    int n = x1 - x0;
+    int passes = radii.size();
+
+    // Per pass: ring of the rows it produced (last pass writes 'output'), then its sums
+    int ringRows[kMaxBoxPasses];
+    int delay[kMaxBoxPasses];
+    size_t total = 0;
+    for (int i = 0; i < passes; ++i) {
+        ringRows[i] = (i + 1 < passes) ? 2 * radii[i + 1] + 2 : 0;
+        delay[i] = (i > 0) ? delay[i - 1] + radii[i] + 1 : 0;
+        total += static_cast<size_t>(ringRows[i] + 1) * n;
+    }
+    rings.resize(total);
+    float* ring[kMaxBoxPasses];
+    float* acc[kMaxBoxPasses];
+    float* next = rings.data();
+    for (int i = 0; i < passes; ++i) {
+        ring[i] = next;
+        acc[i] = ring[i] + static_cast<size_t>(ringRows[i]) * n;
+        next = acc[i] + n;
+    }
+
+    // Row y of the source of pass i, clamped to the image
+    auto sourceRow = [&](int i, int y) -> const float* {
+        y = std::clamp(y, 0, h - 1);
+        if (i == 0) return input.row(y) + x0;
+        return ring[i - 1] + static_cast<size_t>(y % ringRows[i - 1]) * n;
+    };
+
+    for (int t = 0; t < h + delay[passes - 1]; ++t) {
+        for (int i = 0; i < passes; ++i) {
+            int y = t - delay[i]; // row pass i emits at step t
+            if (y < 0 || y >= h) continue;
+            int radius = radii[i];
+            float norm = 1.0f / (2 * radius + 1);
+            float* sum = acc[i];
+            if (y == 0) {
+                std::fill(sum, sum + n, 0.0f);
+                for (int k = -radius; k <= radius; ++k) {
+                    const float* in = sourceRow(i, k);
+                    #pragma omp simd
+                    for (int j = 0; j < n; ++j) sum[j] += in[j];
+                }
+            }
+            const float* enter = sourceRow(i, y + radius + 1);
+            const float* leave = sourceRow(i, y - radius);
+            float* out = (i == passes - 1) ? output.row(y) + x0
+                                           : ring[i] + static_cast<size_t>(y % ringRows[i]) * n;
+            #pragma omp simd
+            for (int j = 0; j < n; ++j) {
+                out[j] = sum[j] * norm;
+                sum[j] += enter[j] - leave[j];
+            }
+        }
+    }
+}
+
+void GaussianBlurBox(ConstImageView input, Image& output, Image& tempBuffer, float sigma, int passes) {
+    XDoGWorkspace workspace;
+    GaussianBlurBox(input, output, tempBuffer, sigma, passes, workspace);
+}
+
+void GaussianBlurBox(ConstImageView input, Image& output, Image& tempBuffer, float sigma, int passes,
+                     XDoGWorkspace& workspace) {
+    int w = input.width;
+    int h = input.height;
+    if (tempBuffer.width != w || tempBuffer.height != h) 
+        tempBuffer.resize(w, h);
+    if (output.width != w || output.height != h) 
+        output.resize(w, h);
+    const std::vector<int>& radii = workspace.boxRadii(sigma, passes);
+
+    // One scratch buffer serves both passes: transposed rows, then strip rings
+    std::vector<float>& buffer = workspace.rowBuffer(0);
+    buffer.resize(std::max(buffer.size(), static_cast<size_t>(2 * w) * kBoxRows));
+    const float* inRows[kBoxRows];
+    float* outRows[kBoxRows];
+    for (int y0 = 0; y0 < h; y0 += kBoxRows) {
+        int count = std::min(kBoxRows, h - y0);
+        for (int r = 0; r < count; ++r) {
+            inRows[r] = input.row(y0 + r);
+            outRows[r] = tempBuffer.row(y0 + r);
+        }
+        box_x_rows(inRows, outRows, count, w, radii, buffer.data());
+    }
+
+    for (int x0 = 0; x0 < w; x0 += kBoxStrip) {
+        box_y_columns(tempBuffer, output, x0, std::min(x0 + kBoxStrip, w), radii, buffer);
+    }
+}
+
+BlurPlan planBlur(float sigma, const XDoGOptions& options, XDoGWorkspace& workspace) {
+    BlurPlan plan;
+    plan.box = options.blurMode == BlurMode::Box;
+    plan.recursive = !plan.box && useRecursiveBlur(options, sigma);
+    if (plan.box) plan.radii = &workspace.boxRadii(sigma, options.boxPasses);
+    else if (plan.recursive) plan.c = workspace.iirCoefficients(sigma);
+    else plan.kernel = &workspace.kernel(sigma);
+    return plan;
+}
+
+BlurPlan planDirectBlur(float sigma, XDoGWorkspace& workspace) {
+    BlurPlan plan;
+    plan.kernel = &workspace.kernel(sigma);
+    return plan;
+}
+
+int blurRowBlocks(int h) {
+    return (h + kBlurBlockRows - 1) / kBlurBlockRows;
+}
+
+int blurColumnItems(const BlurPlan& plan, int w, int h) {
+    if (plan.box) return (w + kBoxStrip - 1) / kBoxStrip;
+    if (plan.recursive) return (w + kIIRStrip - 1) / kIIRStrip;
+    return blurRowBlocks(h);
+}
+
+void blurRowBlock(const BlurPlan& plan, ConstImageView input, ImageView temp, int block,
+                  std::vector<float>& buffer) {
+    int w = input.width;
+    int y0 = block * kBlurBlockRows;
+    int y1 = std::min(y0 + kBlurBlockRows, input.height);
+    const float* inRows[kBlurBlockRows];
+    float* outRows[kBlurBlockRows];
+    for (int y = y0; y < y1; ++y) {
+        inRows[y - y0] = input.row(y);
+        outRows[y - y0] = temp.row(y);
+    }
+    if (plan.box) {
+        buffer.resize(std::max(buffer.size(), static_cast<size_t>(2 * w) * kBoxRows));
+        for (int b = 0; b < y1 - y0; b += kBoxRows) {
+            box_x_rows(inRows + b, outRows + b, std::min(kBoxRows, y1 - y0 - b), w, *plan.radii, buffer.data());
+        }
+    } else if (plan.recursive) {
+        buffer.resize(std::max(buffer.size(), static_cast<size_t>(w + plan.c.pad + 6) * kIIRRows));
+        for (int b = 0; b < y1 - y0; b += kIIRRows) {
+            iir_x_rows(inRows + b, outRows + b, std::min(kIIRRows, y1 - y0 - b), w, plan.c, buffer.data());
+        }
+    } else {
+        for (int y = y0; y < y1; ++y) {
+            convolve_x_row(input.row(y), temp.row(y), w, plan.kernel->data(), plan.kernel->size());
+        }
+    }
+}
+
+void blurColumnItem(const BlurPlan& plan, ConstImageView temp, ImageView output, int item,
+                    std::vector<float>& buffer, std::vector<const float*>& rows) {
+    int w = temp.width;
+    int h = temp.height;
+    if (plan.box || plan.recursive) {
+        int strip = plan.box ? kBoxStrip : kIIRStrip;
+        int x0 = item * strip;
+        int x1 = std::min(x0 + strip, w);
+        if (plan.box) box_y_columns(temp, output, x0, x1, *plan.radii, buffer);
+        else iir_y_columns(temp, output, x0, x1, plan.c, buffer);
+        return;
+    }
+    int kSize = plan.kernel->size();
+    int radius = kSize / 2;
+    if (rows.size() < static_cast<size_t>(kSize)) rows.resize(kSize);
+    for (int y = item * kBlurBlockRows; y < std::min((item + 1) * kBlurBlockRows, h); ++y) {
+        for (int j = 0; j < kSize; ++j) {
+            rows[j] = temp.row(std::clamp(y + j - radius, 0, h - 1));
+        }
+        convolve_y_row(rows.data(), output.row(y), w, plan.kernel->data(), kSize);
+    }
+}
+
+void GaussianBlurPair(ConstImageView input, Image& g1, Image& g2, float sigma, float k, const XDoGOptions& options) {
+    XDoGWorkspace workspace;
+    GaussianBlurPair(input, g1, g2, sigma, k, options, workspace);
+}
+
+void GaussianBlurPair(ConstImageView input, Image& g1, Image& g2, float sigma, float k, const XDoGOptions& options,
+                      XDoGWorkspace& workspace) {
+    Image& temp1 = workspace.temp1;
+    XDoGOptions pair = resolveBlurPair(options, sigma, k);
+    bool recursive1 = useRecursiveBlur(pair, sigma);
+    bool recursive2 = useRecursiveBlur(pair, sigma * k);
+
+    if (options.blurMode == BlurMode::Cascaded && k > 1.0f) {
+        // g2 is derived from g1 with the short residual kernel
+        GaussianBlurRaw(input, g1, temp1, sigma, 0.0f, workspace);
+        GaussianBlurRaw(g1, g2, temp1, sigma * k, sigma, workspace);
+        fixCascadeBorder(input, g2, temp1, sigma * k, sigma, workspace);
+    } else if (options.blurMode == BlurMode::Box) {
+        // Fast approximation, cost independent of sigma
+        GaussianBlurBox(input, g1, temp1, sigma, options.boxPasses, workspace);
+        GaussianBlurBox(input, g2, temp1, sigma * k, options.boxPasses, workspace);
+    } else if (recursive1 || recursive2) {
+        // Large sigmas: constant-cost recursive filter
+        if (recursive1) GaussianBlurIIR(input, g1, temp1, sigma, workspace);
+        else GaussianBlurRaw(input, g1, temp1, sigma, 0.0f, workspace);
+        if (recursive2) GaussianBlurIIR(input, g2, temp1, sigma * k, workspace);
+        else GaussianBlurRaw(input, g2, temp1, sigma * k, 0.0f, workspace);
+    } else {
+        // Both blurs share a single read of the input, with cached kernels
+        // and no temporaries
+        int w = input.width;
+        int h = input.height;
+        Image& temp2 = workspace.temp2;
+        temp1.resize(w, h);
+        temp2.resize(w, h);
+        g1.resize(w, h);
+        g2.resize(w, h);
+        const std::vector<float>& kernel1 = workspace.kernel(sigma);
+        const std::vector<float>& kernel2 = workspace.kernel(sigma * k);
+
+        for (int y = 0; y < h; ++y) {
+            const float* row = input.row(y);
+            convolve_x_row(row, temp1.row(y), w, kernel1.data(), kernel1.size());
+            convolve_x_row(row, temp2.row(y), w, kernel2.data(), kernel2.size());
+        }
+        convolve_y(temp1, g1, kernel1, workspace.rowPointers(0));
+        convolve_y(temp2, g2, kernel2, workspace.rowPointers(0));
+    }
+}
+
+// ... (applyDoG remains the same) ...
+
+Image applyXDoG(ConstImageView input, float sigma, float k, float p, float epsilon, float phi,
+                const XDoGOptions& options) {
+    // temp1 is dead by the time the result is written, so it becomes the result
+    XDoGWorkspace workspace;
+    applyXDoG(input, workspace.temp1, sigma, k, p, epsilon, phi, options, workspace);
+    return std::move(workspace.temp1);
+}
+
+void applyXDoG(ConstImageView input, Image& output, float sigma, float k, float p, float epsilon, float phi,
+               const XDoGOptions& options, XDoGWorkspace& workspace) {
+    // Sized before the blurs, so scratch use of temp1 never reallocates it
+    output.resize(input.width, input.height);
+    applyXDoG(input, ImageView(output), sigma, k, p, epsilon, phi, options, workspace);
+}
+
+void applyXDoG(ConstImageView input, ImageView output, float sigma, float k, float p, float epsilon, float phi,
+               const XDoGOptions& options, XDoGWorkspace& workspace) {
+    GaussianBlurPair(input, workspace.g1, workspace.g2, sigma, k, options, workspace);
+
+    // Black lines on white background (see xdogThreshold), row by row
+    int w = input.width;
+    for (int y = 0; y < input.height; ++y) {
+        xdog_row(workspace.g1.row(y), workspace.g2.row(y), output.row(y), w, p, epsilon, phi, options.tanhMode);
+    }
+}
+
+float maxAbsDifference(ConstImageView a, ConstImageView b) {
+    int w = std::min(a.width, b.width);
+    int h = std::min(a.height, b.height);
+    float maxDiff = 0.0f;
+    for (int y = 0; y < h; ++y) {
+        const float* rowA = a.row(y);
+        const float* rowB = b.row(y);
+        for (int x = 0; x < w; ++x) {
+            maxDiff = std::max(maxDiff, std::fabs(rowA[x] - rowB[x]));
+        }
+    }
+    return maxDiff;
+}
+
+double computePSNR(ConstImageView a, ConstImageView reference) {
+    int w = std::min(a.width, reference.width);
+    int h = std::min(a.height, reference.height);
+    double squaredError = 0.0;
+    for (int y = 0; y < h; ++y) {
+        const float* rowA = a.row(y);
+        const float* rowRef = reference.row(y);
+        for (int x = 0; x < w; ++x) {
+            double diff = rowA[x] - rowRef[x];
+            squaredError += diff * diff;
+        }
+    }
+    double mse = squaredError / (static_cast<double>(w) * h);
+    if (mse == 0.0) return INFINITY;
+    return 10.0 * std::log10(255.0 * 255.0 / mse);
 }
 
 // ... (Rest of file_manager logic remains the same) ...
-Image convertToFloatImage(const FileManager& fm) {
-    int w = fm.getWidth();
-    int h = fm.getHeight();
-    int c = fm.getChannels();
-    std::vector<unsigned char> raw = fm.getImageData();
-    Image img(w, h);
-    size_t size = w * h;
-    const unsigned char* pRaw = raw.data();
-    float* pImg = img.data.data();
-    if (c == 1) {
-        for (size_t i = 0; i < size; ++i) pImg[i] = static_cast<float>(pRaw[i]);
-    } else if (c >= 3) {
-        for (size_t i = 0; i < size; ++i) {
-            int idx = i * c;
-            pImg[i] = 0.299f * pRaw[idx] + 0.587f * pRaw[idx+1] + 0.114f * pRaw[idx+2];
+void luma_row(const unsigned char* pixels, float* out, int w, int channels) {
+    if (channels < 3) {
+        #pragma omp simd
+        for (int x = 0; x < w; ++x) out[x] = static_cast<float>(pixels[x * channels]);
+    } else {
+        #pragma omp simd
+        for (int x = 0; x < w; ++x) {
+            const unsigned char* px = &pixels[x * channels];
+            out[x] = 0.299f * px[0] + 0.587f * px[1] + 0.114f * px[2];
         }
     }
-    return img;
 }
 
-FileManager convertToFMImage(const Image& img) {
-    std::vector<unsigned char> bytes(img.width * img.height);
-    size_t size = img.data.size();
-    const float* pData = img.data.data();
-    unsigned char* pBytes = bytes.data();
-    for (size_t i = 0; i < size; ++i) {
-        float val = pData[i];
+void quantize_row(const float* in, unsigned char* out, int w) {
+    #pragma omp simd
+    for (int x = 0; x < w; ++x) {
+        float val = in[x];
         if (val < 0.0f) val = 0.0f;
         else if (val > 255.0f) val = 255.0f;
-        pBytes[i] = static_cast<unsigned char>(val);
+        out[x] = static_cast<unsigned char>(val);
+    }
+}
+
+void convertToFloatImage(const FileManager& fm, Image& img) {
+    PixelView pixels = fm.getPixelView();
+    int w = pixels.width;
+    int h = pixels.height;
+    img.resize(w, h);
+    for (int y = 0; y < h; ++y) {
+        luma_row(pixels.row(y), img.row(y), w, pixels.channels);
+    }
+}
+
+Image convertToFloatImage(const FileManager& fm) {
+    Image img(0, 0);
+    convertToFloatImage(fm, img);
+    return img;
+}
+FileManager convertToFMImage(ConstImageView img) {
+    // Quantize straight into the buffer the FileManager adopts, no extra copy
+    int w = img.width;
+    unsigned char* pBytes = FileManager::allocateImageData(static_cast<size_t>(w) * img.height);
+    if (!pBytes) return FileManager();
+    for (int y = 0; y < img.height; ++y) {
+        quantize_row(img.row(y), &pBytes[static_cast<size_t>(y) * w], w);
     }
-    return FileManager(bytes.data(), img.width, img.height, 1);
+    return FileManager(pBytes, img.width, img.height, 1, FileManager::AdoptBuffer());
 }
\ No newline at end of file
@@ -2,33 +2,428 @@
 #define SEQ_DIFF_GAUSS_H
 
 #include <vector>
+#include <deque>
+#include <utility>
 #include <cmath>
 #include <algorithm>
+#include <new>
+#include <cstddef>
 #include "file_manager.h" 
 
+// Planes are allocated on kImageAlign-byte boundaries and every row starts
+// on one: a cache line, one full AVX-512 vector.
+const int kImageAlign = 64;
+const int kImageAlignFloats = kImageAlign / sizeof(float);
+
+// std::allocator with kImageAlign alignment, for the plane storage
+template <typename T>
+struct AlignedAllocator {
+    using value_type = T;
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(kImageAlign)));
+    }
+    void deallocate(T* p, size_t) { ::operator delete(p, std::align_val_t(kImageAlign)); }
+
+    // Default-initialises, i.e. a float without a value is left untouched:
+    // fresh storage is only written (first-touched) by whoever fills it
+    template <typename U>
+    void construct(U* p) { ::new (static_cast<void*>(p)) U; }
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) { ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...); }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U>&) const { return false; }
+};
+
+// Single-channel float plane. Rows are 'stride' floats apart, which is padded
+// past width (see paddedStride), so always address pixels through row(y)
+// rather than y * width. An optional halo of 'halo' pixels surrounds the
+// image on every side; row(y)[-halo .. width + halo) and rows -halo ..
+// height + halo - 1 are valid memory, filled by extendBorder().
 struct Image {
     int width;
     int height;
-    std::vector<float> data; 
+    int halo;
+    int stride;
+    std::vector<float, AlignedAllocator<float>> data; // Padded plane, halo included
+
+    Image(int w, int h, int haloSize = 0) : width(0), height(0), halo(haloSize), stride(0) {
+        resize(w, h);
+    }
 
-    Image(int w, int h) : width(w), height(h), data(w * h) {}
-    
+    // Keeps the halo; contents are unspecified afterwards, capacity is kept
     void resize(int w, int h) {
         width = w;
         height = h;
-        if (data.size() != static_cast<size_t>(w * h)) {
-            data.resize(w * h);
+        stride = paddedStride(w, halo);
+        size_t size = static_cast<size_t>(stride) * (h + 2 * halo);
+        if (data.size() != size) {
+            data.resize(size, 0.0f);
         }
     }
+
+    // Same, except that storage which has to grow is allocated afresh and
+    // left untouched rather than zeroed on the calling thread. Returns true
+    // in that case: the caller then writes every row, and under first-touch
+    // NUMA placement each page lands on the node of the thread writing it.
+    bool resizeUntouched(int w, int h) {
+        size_t size = static_cast<size_t>(paddedStride(w, halo)) * (h + 2 * halo);
+        if (size <= data.capacity()) {
+            resize(w, h);
+            return false;
+        }
+        width = w;
+        height = h;
+        stride = paddedStride(w, halo);
+        data = decltype(data)(); // Release rather than copy the old pages over
+        data.resize(size);
+        return true;
+    }
+
+    float* row(int y) { return data.data() + origin() + static_cast<ptrdiff_t>(y) * stride; }
+    const float* row(int y) const { return data.data() + origin() + static_cast<ptrdiff_t>(y) * stride; }
+
+    // Replicates the edge pixels into the halo (clamp-to-edge, like the kernels)
+    void extendBorder();
+
+    // Row length for 'w' pixels plus halo: the left margin is rounded up so
+    // row(y) stays aligned, the total to whole vectors. Strides that are a
+    // multiple of 4 KiB get one more vector, otherwise vertically adjacent
+    // pixels map to the same cache set and loads falsely alias stores.
+    static int paddedStride(int w, int halo) {
+        int margin = roundUp(halo, kImageAlignFloats);
+        int s = roundUp(margin + w + halo, kImageAlignFloats);
+        if (s > 0 && (s * sizeof(float)) % 4096 == 0) s += kImageAlignFloats;
+        return s;
+    }
+
+private:
+    static int roundUp(int n, int multiple) { return (n + multiple - 1) / multiple * multiple; }
+    size_t origin() const {
+        return static_cast<size_t>(halo) * stride + roundUp(halo, kImageAlignFloats);
+    }
+};
+
+// Non-owning window onto a float plane: width x height pixels whose rows are
+// 'stride' floats apart. sub() describes a rectangle of it without copying.
+// Kernels treat the edges of a view as the image edges (clamp-to-edge): to
+// filter a region with its real surroundings, pass a view grown by the kernel
+// radius and keep the interior of the result.
+struct ImageView {
+    float* data = nullptr;
+    int width = 0;
+    int height = 0;
+    int stride = 0; // Floats from one row to the next
+
+    ImageView() = default;
+    ImageView(float* d, int w, int h, int s) : data(d), width(w), height(h), stride(s) {}
+    ImageView(Image& img) : data(img.row(0)), width(img.width), height(img.height), stride(img.stride) {}
+
+    float* row(int y) const { return data + static_cast<ptrdiff_t>(y) * stride; }
+    ImageView sub(int x, int y, int w, int h) const { return ImageView(row(y) + x, w, h, stride); }
+    bool empty() const { return width == 0 || height == 0; }
 };
 
-// Internal helper for buffer reuse
-void GaussianBlurRaw(const Image& input, Image& output, Image& tempBuffer, float sigma);
+// Read-only counterpart of ImageView; every Image and ImageView converts to it
+struct ConstImageView {
+    const float* data = nullptr;
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+
+    ConstImageView() = default;
+    ConstImageView(const float* d, int w, int h, int s) : data(d), width(w), height(h), stride(s) {}
+    ConstImageView(const Image& img) : data(img.row(0)), width(img.width), height(img.height), stride(img.stride) {}
+    ConstImageView(const ImageView& v) : data(v.data), width(v.width), height(v.height), stride(v.stride) {}
+
+    const float* row(int y) const { return data + static_cast<ptrdiff_t>(y) * stride; }
+    ConstImageView sub(int x, int y, int w, int h) const { return ConstImageView(row(y) + x, w, h, stride); }
+    bool empty() const { return width == 0 || height == 0; }
+};
+
+// How the two blurs of XDoG are produced
+enum class BlurMode {
+    Direct,    // FIR kernels, both blurs straight from the input (see GaussianBlurPair)
+    Cascaded,  // g2 = blur(g1, sqrt((k*sigma)^2 - sigma^2)), a much shorter kernel
+    Recursive, // Young-van Vliet IIR Gaussian, cost per pixel independent of sigma
+    Box,       // Approximation by boxPasses stacked box filters (running sums)
+    Auto       // Recursive for sigma >= kRecursiveSigmaThreshold, Direct below (see resolveBlurPair)
+};
+
+// From this sigma on the recursive Gaussian is faster than the FIR kernels
+// (crossover measured around 5.5 with AVX-512, lower on narrower vectors)
+const float kRecursiveSigmaThreshold = 5.0f;
+
+// How the XDoG soft threshold evaluates tanh
+enum class TanhMode {
+    Libm,     // std::tanh (vectorized only where libmvec is available)
+    Rational  // Inline rational approximation, see rationalTanh
+};
+
+// Upper bound of XDoGOptions::boxPasses
+const int kMaxBoxPasses = 5;
+
+// XDoGOptions::tileSize value asking for tiles sized to the L2 cache
+const int kTileAuto = -1;
+
+// Young-van Vliet coefficients, the same recursion runs forward then backward:
+// w[n] = B * x[n] + a1 * w[n-1] + a2 * w[n-2] + a3 * w[n-3]
+struct IIRCoefficients {
+    float B;
+    float a1, a2, a3;
+    int pad; // Samples of edge extension run past the end before turning back
+};
+
+IIRCoefficients computeIIRCoefficients(float sigma);
+
+// Optional knobs for the XDoG pipelines
+struct XDoGOptions {
+    BlurMode blurMode = BlurMode::Direct;
+    TanhMode tanhMode = TanhMode::Libm;
+    int boxPasses = 3; // BlurMode::Box only, 3..kMaxBoxPasses (more passes = closer to Gaussian)
+    int tileSize = 0;  // applyXDoGTiled_OMP only: tile edge in pixels, or kTileAuto
+};
+
+// Scratch state reused across XDoG calls, so that steady-state processing of
+// same-sized frames does no heap allocation. Planes only ever grow (resizing
+// an Image keeps its capacity); kernels, IIR coefficients and box radii are
+// computed once per distinct sigma.
+struct XDoGWorkspace {
+    Image g1{0, 0};
+    Image g2{0, 0};
+    Image temp1{0, 0};
+    Image temp2{0, 0};
+    Image luma{0, 0}; // Float copy of an 8-bit input, when a backend needs one
+
+    // Normalised Gaussian kernel for 'sigma'. References stay valid for the
+    // lifetime of the workspace.
+    const std::vector<float>& kernel(float sigma);
+    const IIRCoefficients& iirCoefficients(float sigma);
+    const std::vector<int>& boxRadii(float sigma, int passes);
+
+    // Per-thread scratch rows / row-pointer tables. Call reserveThreads()
+    // outside a parallel region before indexing by thread number inside it.
+    void reserveThreads(int count);
+    std::vector<float>& rowBuffer(int thread) { return rowBuffers[thread]; }
+    std::vector<const float*>& rowPointers(int thread) { return rowPointerTables[thread]; }
+
+    // Per-band progress flags of the single-region OpenMP pipeline
+    std::vector<int> bandFlags;
+
+private:
+    struct BoxRadii {
+        float sigma;
+        int passes;
+        std::vector<int> radii;
+    };
+    std::deque<std::pair<float, std::vector<float>>> kernels;
+    std::deque<std::pair<float, IIRCoefficients>> iirCoefficientSets;
+    std::deque<BoxRadii> boxRadiiSets;
+    std::vector<std::vector<float>> rowBuffers = std::vector<std::vector<float>>(1);
+    std::vector<std::vector<const float*>> rowPointerTables = std::vector<std::vector<const float*>>(1);
+};
+
+// Whether a blur of 'sigma' runs on the recursive Gaussian under these options
+bool useRecursiveBlur(const XDoGOptions& options, float sigma);
+
+// 'options' with Auto resolved for the blurs of 'sigma' and 'sigma * k': both
+// recursive once the narrower one reaches kRecursiveSigmaThreshold, both
+// direct below. A pair split across the two engines differs from either
+// engine's result by far more than they differ from each other. Auto is
+// opt-in: the XDoG threshold amplifies the recursive blur's error (up to
+// about 2 levels) roughly 1 + 2p times, which moves edges visibly.
+XDoGOptions resolveBlurPair(const XDoGOptions& options, float sigma, float k);
+
+// Default small-sigma path: both blurs direct, eligible for the fused kernels
+bool useFusedXDoG(float sigma, float k, const XDoGOptions& options);
+
+// Sigma still to apply to an image already blurred by inputSigma to reach
+// targetSigma. Gaussians compose by adding variances.
+float cascadeSigma(float targetSigma, float inputSigma);
+
+// Internal helper for buffer reuse.
+// If 'input' already carries a Gaussian blur of inputSigma (cascaded mode),
+// only the residual cascadeSigma(sigma, inputSigma) is applied.
+// Here and below, the overloads taking an XDoGWorkspace draw their kernels,
+// coefficients and scratch rows from it instead of allocating per call.
+void GaussianBlurRaw(ConstImageView input, Image& output, Image& tempBuffer, float sigma, float inputSigma = 0.0f);
+void GaussianBlurRaw(ConstImageView input, Image& output, Image& tempBuffer, float sigma, float inputSigma,
+                     XDoGWorkspace& workspace);
+
+// Completes a cascaded blur: recomputes the border band (residual radius wide),
+// where clamp-to-edge makes the cascade deviate, directly from 'input'.
+void fixCascadeBorder(ConstImageView input, Image& output, Image& tempBuffer, float sigma, float inputSigma);
+void fixCascadeBorder(ConstImageView input, Image& output, Image& tempBuffer, float sigma, float inputSigma,
+                      XDoGWorkspace& workspace);
+
+// Recursive (IIR) Gaussian blur, O(1) per pixel regardless of sigma.
+// Borders are extended with the edge value, like the FIR kernels' clamp.
+void GaussianBlurIIR(ConstImageView input, Image& output, Image& tempBuffer, float sigma);
+void GaussianBlurIIR(ConstImageView input, Image& output, Image& tempBuffer, float sigma,
+                     XDoGWorkspace& workspace);
+
+// Rows filtered together by the horizontal recursive pass (SIMD across rows)
+const int kIIRRows = 16;
+
+// Recursive pass building blocks, shared with the OpenMP backend
+void iir_x_rows(const float* const* inRows, float* const* outRows, int count, int w,
+                const IIRCoefficients& c, float* buffer);
+void iir_y_columns(ConstImageView input, ImageView output, int x0, int x1,
+                   const IIRCoefficients& c, std::vector<float>& edgeBuffer);
+
+// Approximate Gaussian blur from 'passes' successive box filters per axis,
+// computed with running sums so the cost per pixel does not depend on sigma.
+void GaussianBlurBox(ConstImageView input, Image& output, Image& tempBuffer, float sigma, int passes);
+void GaussianBlurBox(ConstImageView input, Image& output, Image& tempBuffer, float sigma, int passes,
+                     XDoGWorkspace& workspace);
+
+// Radii of the box filters whose stack best matches a Gaussian of 'sigma'
+std::vector<int> boxRadiiForGauss(float sigma, int passes);
+
+// Box pass building blocks, shared with the OpenMP backend: blocks of
+// kBoxRows rows horizontally, strips of kBoxStrip columns vertically.
+const int kBoxRows = 16;
+const int kBoxStrip = 512;
+void box_x_rows(const float* const* inRows, float* const* outRows, int count, int w,
+                const std::vector<int>& radii, float* buffer);
+void box_y_columns(ConstImageView input, ImageView output, int x0, int x1,
+                   const std::vector<int>& radii, std::vector<float>& strip);
+
+// Work items of the threaded backends (OpenMP tasks, thread pool): a blur's
+// horizontal pass in row blocks, its vertical pass in column strips (box,
+// recursive) or row blocks (direct).
+
+// Rows per block (a multiple of kBoxRows and kIIRRows). Bands of the direct
+// passes are also at least a kernel radius tall, so the vertical taps of a
+// band reach no further than its neighbours.
+const int kBlurBlockRows = 32;
+
+// Columns per strip of the vertical recursive pass
+const int kIIRStrip = 512;
+
+// One blur of 'sigma' as selected by the options (not cascaded), kernels
+// fetched up front (from the workspace caches) so the work items only touch
+// pixel rows
+struct BlurPlan {
+    bool box = false;
+    bool recursive = false;
+    const std::vector<int>* radii = nullptr;
+    IIRCoefficients c{};
+    const std::vector<float>* kernel = nullptr;
+};
+
+BlurPlan planBlur(float sigma, const XDoGOptions& options, XDoGWorkspace& workspace);
+BlurPlan planDirectBlur(float sigma, XDoGWorkspace& workspace);
+
+// Work items of each pass over a w x h plane
+int blurRowBlocks(int h);
+int blurColumnItems(const BlurPlan& plan, int w, int h);
+
+// Horizontal pass of row block 'block' of 'input' into 'temp'. 'buffer' is
+// per-thread scratch.
+void blurRowBlock(const BlurPlan& plan, ConstImageView input, ImageView temp, int block,
+                  std::vector<float>& buffer);
+// Vertical pass of item 'item' of 'temp' into 'output', with per-thread
+// scratch 'buffer' and 'rows'
+void blurColumnItem(const BlurPlan& plan, ConstImageView temp, ImageView output, int item,
+                    std::vector<float>& buffer, std::vector<const float*>& rows);
+
+// tanh as a 13/6 odd rational polynomial (minimax coefficients as used by
+// Eigen). Only mul/add/div/select, so it inlines into any SIMD loop.
+// Max absolute error vs double tanh: 3e-7 over all x, i.e. < 1e-4 gray levels.
+// Past the rational's range the tail follows float tanh: one ulp below 1 up
+// to |x| = 9.0109, exactly 1 beyond. The 8-bit conversion truncates, so this
+// ulp decides whether flat background lands on 254 or 255.
+inline float rationalTanh(float x) {
+    float ax = std::fabs(x);
+    float tail = std::copysign(ax >= 9.01091385f ? 1.0f : 0.99999994f, x);
+    x = std::clamp(x, -7.90531110763549805f, 7.90531110763549805f);
+    float x2 = x * x;
+    float num = -2.76076847742355e-16f;
+    num = num * x2 + 2.00018790482477e-13f;
+    num = num * x2 - 8.60467152213735e-11f;
+    num = num * x2 + 5.12229709037114e-08f;
+    num = num * x2 + 1.48572235717979e-05f;
+    num = num * x2 + 6.37261928875436e-04f;
+    num = num * x2 + 4.89352455891786e-03f;
+    float den = 1.19825839466702e-06f;
+    den = den * x2 + 1.18534705686654e-04f;
+    den = den * x2 + 2.26843463243900e-03f;
+    den = den * x2 + 4.89352518554385e-03f;
+    return ax >= 7.90531110763549805f ? tail : x * num / den;
+}
+
+// XDoG response of one pixel from its two blurs: sharpened difference on the
+// 0-100 scale, soft-thresholded with tanh, inverted to black lines on white.
+inline float xdogThreshold(float g1, float g2, float p, float epsilon, float phi,
+                           TanhMode tanhMode = TanhMode::Libm) {
+    float scaledDifference = (1.0f + p) * g1 - p * g2;
+    float val = scaledDifference / 255.0f * 100.0f;
+
+    float result;
+    if (val >= epsilon) {
+        result = 1.0f;
+    } else {
+        float x = phi * (val - epsilon);
+        result = 1.0f + (tanhMode == TanhMode::Rational ? rationalTanh(x) : std::tanh(x));
+    }
+
+    float finalVal = 255.0f - (result * 255.0f);
+    if (finalVal < 0.0f) finalVal = 0.0f;
+    if (finalVal > 255.0f) finalVal = 255.0f;
+    return finalVal;
+}
+
+// xdogThreshold over n pixels. The tanh choice is made once outside the SIMD
+// loop (a per-pixel select would evaluate both implementations).
+void xdog_row(const float* g1, const float* g2, float* out, int n,
+              float p, float epsilon, float phi, TanhMode tanhMode);
+
+// Vertical FIR pass of the g2 blur with the XDoG epilogue fused in: the
+// blurred value never leaves registers, out[x] = xdogThreshold(g1Row[x], g2).
+void convolve_y_xdog_row(const float* const* rows, const float* g1Row, float* out, int w,
+                         const float* kernel, int kSize, float p, float epsilon, float phi,
+                         TanhMode tanhMode);
+
+// The two XDoG blurs, g1 = blur(sigma) and g2 = blur(sigma * k), as selected by options
+void GaussianBlurPair(ConstImageView input, Image& g1, Image& g2, float sigma, float k, const XDoGOptions& options);
+// Same, with scratch planes and kernels taken from 'workspace'
+void GaussianBlurPair(ConstImageView input, Image& g1, Image& g2, float sigma, float k, const XDoGOptions& options,
+                      XDoGWorkspace& workspace);
+
+Image applyDoG(ConstImageView input, float sigma, float k, float tau);
+Image applyXDoG(ConstImageView input, float sigma, float k, float p, float epsilon, float phi,
+                const XDoGOptions& options = XDoGOptions());
+// Allocation-free form for repeated calls: 'output' is resized as needed and
+// all intermediates live in 'workspace'. 'output' may be workspace.temp1.
+void applyXDoG(ConstImageView input, Image& output, float sigma, float k, float p, float epsilon, float phi,
+               const XDoGOptions& options, XDoGWorkspace& workspace);
+// Same, writing into an input-sized view, e.g. a region of a larger plane.
+// The view must not overlap the input or any workspace plane but temp1.
+void applyXDoG(ConstImageView input, ImageView output, float sigma, float k, float p, float epsilon, float phi,
+               const XDoGOptions& options, XDoGWorkspace& workspace);
+
+// Largest absolute per-pixel difference between two same-sized images
+float maxAbsDifference(ConstImageView a, ConstImageView b);
+
+// Peak signal-to-noise ratio of 'a' against 'reference' in dB (0-255 scale)
+double computePSNR(ConstImageView a, ConstImageView reference);
 
-Image applyDoG(const Image& input, float sigma, float k, float tau);
-Image applyXDoG(const Image& input, float sigma, float k, float p, float epsilon, float phi);
+// One row of interleaved 8-bit pixels (gray, gray+alpha, RGB or RGBA) to float luma
+void luma_row(const unsigned char* pixels, float* out, int w, int channels);
+// One row of float gray values to 8-bit, clamped to 0-255 and truncated
+void quantize_row(const float* in, unsigned char* out, int w);
 
 Image convertToFloatImage(const FileManager& fm);
-FileManager convertToFMImage(const Image& img);
+// Same, into 'img' (resized as needed)
+void convertToFloatImage(const FileManager& fm, Image& img);
+FileManager convertToFMImage(ConstImageView img);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "stream_diff_gauss.hpp"
+#include <algorithm>
+#include <utility>
+
+// Reuse kernel generator and the SIMD row kernels
+extern std::vector<float> create1dGaussianKernel(float sigma);
+extern void convolve_x_row(const float* row, float* out, int w, const float* kernel, int kSize);
+extern void convolve_y_row(const float* const* rows, float* out, int w, const float* kernel, int kSize);
+
+const float* PixelRowSource::readRow() {
+    if (next >= pixels.height) return nullptr;
+    luma_row(pixels.row(next++), luma.data(), pixels.width, pixels.channels);
+    return luma.data();
+}
+
+bool ImageRowSink::writeRow(const float* row) {
+    if (next >= image.height) return false;
+    std::copy(row, row + image.width, image.row(next++));
+    return true;
+}
+
+bool GrayRowSink::writeRow(const float* row) {
+    if (next >= height) return false;
+    quantize_row(row, &pixels[static_cast<size_t>(next++) * width], width);
+    return true;
+}
+
+StreamingBlur::StreamingBlur(int width, std::vector<float> weights, int lookahead)
+    : kernel(std::move(weights)),
+      radiusPx(kernel.size() / 2),
+      ring(width, radiusPx + std::max(radiusPx, lookahead) + 1),
+      rowTable(kernel.size()) {}
+
+void StreamingBlur::push(const float* row) {
+    float* slot = ring.row(pushed % ring.height);
+    convolve_x_row(row, slot, ring.width, kernel.data(), kernel.size());
+    ++pushed;
+}
+
+const float* const* StreamingBlur::taps(int y) {
+    int kSize = kernel.size();
+    for (int k = 0; k < kSize; ++k) {
+        int ny = std::clamp(y + k - radiusPx, 0, pushed - 1);
+        rowTable[k] = ring.row(ny % ring.height);
+    }
+    return rowTable.data();
+}
+
+void StreamingBlur::blurRow(int y, float* out) {
+    convolve_y_row(taps(y), out, ring.width, kernel.data(), kernel.size());
+}
+
+void StreamingBlur::blurRowXDoG(int y, const float* g1Row, float* out, float p, float epsilon, float phi,
+                                TanhMode tanhMode) {
+    convolve_y_xdog_row(taps(y), g1Row, out, ring.width, kernel.data(), kernel.size(),
+                        p, epsilon, phi, tanhMode);
+}
+
+bool streamGaussianBlur(RowSource& source, RowSink& sink, float sigma) {
+    int w = source.width();
+    StreamingBlur blur(w, create1dGaussianKernel(sigma));
+    std::vector<float> outRow(w);
+
+    // Row y is complete once row y + radius has been pushed
+    int y = 0;
+    while (const float* row = source.readRow()) {
+        blur.push(row);
+        for (; y + blur.radius() < blur.rowsPushed(); ++y) {
+            blur.blurRow(y, outRow.data());
+            if (!sink.writeRow(outRow.data())) return false;
+        }
+    }
+    // End of input: the remaining rows see the last row replicated
+    for (; y < blur.rowsPushed(); ++y) {
+        blur.blurRow(y, outRow.data());
+        if (!sink.writeRow(outRow.data())) return false;
+    }
+    return blur.rowsPushed() > 0;
+}
+
+bool streamXDoG(RowSource& source, RowSink& sink, float sigma, float k, float p, float epsilon, float phi,
+                TanhMode tanhMode) {
+    int w = source.width();
+    std::vector<float> kernel1 = create1dGaussianKernel(sigma);
+    std::vector<float> kernel2 = create1dGaussianKernel(sigma * k);
+    int lag = std::max(kernel1.size(), kernel2.size()) / 2;
+    StreamingBlur blur1(w, std::move(kernel1), lag);
+    StreamingBlur blur2(w, std::move(kernel2), lag);
+    std::vector<float> g1Row(w);
+    std::vector<float> outRow(w);
+
+    auto emit = [&](int y) {
+        blur1.blurRow(y, g1Row.data());
+        blur2.blurRowXDoG(y, g1Row.data(), outRow.data(), p, epsilon, phi, tanhMode);
+        return sink.writeRow(outRow.data());
+    };
+
+    // Both blurs run 'lag' rows behind the input, the wider one's radius
+    int y = 0;
+    while (const float* row = source.readRow()) {
+        blur1.push(row);
+        blur2.push(row);
+        for (; y + lag < blur1.rowsPushed(); ++y) {
+            if (!emit(y)) return false;
+        }
+    }
+    for (; y < blur1.rowsPushed(); ++y) {
+        if (!emit(y)) return false;
+    }
+    return blur1.rowsPushed() > 0;
+}
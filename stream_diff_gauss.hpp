@@ -0,0 +1,123 @@
+#ifndef STREAM_DIFF_GAUSS_H
+#define STREAM_DIFF_GAUSS_H
+
+#include "seq_diff_gauss.hpp" // Image, views, row kernels
+#include "file_manager.h"
+#include <vector>
+
+// Streaming engine: images pass through top to bottom one row at a time, so
+// memory is proportional to width x kernel height instead of width x height.
+
+// Producer of input rows, top to bottom
+class RowSource {
+public:
+    virtual ~RowSource() = default;
+    virtual int width() const = 0;
+    // Next row (width() floats), valid until the following call;
+    // nullptr once the input is exhausted
+    virtual const float* readRow() = 0;
+};
+
+// Consumer of output rows, top to bottom
+class RowSink {
+public:
+    virtual ~RowSink() = default;
+    // false aborts the stream (e.g. a failed write)
+    virtual bool writeRow(const float* row) = 0;
+};
+
+// Rows of a float plane
+class ImageRowSource : public RowSource {
+public:
+    explicit ImageRowSource(ConstImageView image) : image(image) {}
+    int width() const override { return image.width; }
+    const float* readRow() override { return next < image.height ? image.row(next++) : nullptr; }
+
+private:
+    ConstImageView image;
+    int next = 0;
+};
+
+// Rows of decoded 8-bit pixels, converted to luma on the fly
+class PixelRowSource : public RowSource {
+public:
+    explicit PixelRowSource(const PixelView& pixels) : pixels(pixels), luma(pixels.width) {}
+    int width() const override { return pixels.width; }
+    const float* readRow() override;
+
+private:
+    PixelView pixels;
+    std::vector<float> luma;
+    int next = 0;
+};
+
+// Writes rows into a float plane (extra rows are rejected)
+class ImageRowSink : public RowSink {
+public:
+    explicit ImageRowSink(ImageView image) : image(image) {}
+    bool writeRow(const float* row) override;
+
+private:
+    ImageView image;
+    int next = 0;
+};
+
+// Quantizes rows into a tightly packed 8-bit gray buffer of 'height' rows
+class GrayRowSink : public RowSink {
+public:
+    GrayRowSink(unsigned char* pixels, int width, int height) : pixels(pixels), width(width), height(height) {}
+    bool writeRow(const float* row) override;
+
+private:
+    unsigned char* pixels;
+    int width;
+    int height;
+    int next = 0;
+};
+
+// Vertical ring of horizontally blurred rows for one Gaussian kernel. Each
+// pushed row is blurred along x (convolve_x_row) into the next ring slot;
+// output row y is then the vertical pass (convolve_y_row) over the ring rows
+// y - radius .. y + radius, clamped to the rows pushed so far. The ring holds
+// 2 * radius + 1 rows, plus 'lookahead' - radius when a caller pushes further
+// ahead than this kernel needs (a second, wider kernel on the same stream).
+class StreamingBlur {
+public:
+    StreamingBlur(int width, std::vector<float> weights, int lookahead = 0);
+
+    int radius() const { return radiusPx; }
+    int rowsPushed() const { return pushed; }
+    size_t ringBytes() const { return ring.data.size() * sizeof(float); }
+
+    // Horizontally blurs 'row' into the ring as the next input row
+    void push(const float* row);
+
+    // Output row y. Needs rows up to y + radius pushed, unless the input has
+    // ended (the last row is then replicated), and row y - radius still in the ring.
+    void blurRow(int y, float* out);
+    // Same, with the XDoG epilogue against g1Row fused in (see convolve_y_xdog_row)
+    void blurRowXDoG(int y, const float* g1Row, float* out, float p, float epsilon, float phi,
+                     TanhMode tanhMode);
+
+private:
+    const float* const* taps(int y);
+
+    std::vector<float> kernel;
+    int radiusPx;
+    Image ring;
+    std::vector<const float*> rowTable;
+    int pushed = 0;
+};
+
+// Gaussian blur of a stream. Returns false if the source is empty or the sink fails.
+bool streamGaussianBlur(RowSource& source, RowSink& sink, float sigma);
+
+// XDoG of a stream with direct (FIR) blurs: the same kernels and epilogue as
+// the fused direct path of applyXDoG_OMP, bit for bit. Both blurs see each
+// input row once; output row y leaves as soon as row y + max radius has
+// arrived. Memory: two rings of about width x (2 * max radius + 1) floats.
+// Returns false if the source is empty or the sink fails.
+bool streamXDoG(RowSource& source, RowSink& sink, float sigma, float k, float p, float epsilon, float phi,
+                TanhMode tanhMode = TanhMode::Libm);
+
+#endif
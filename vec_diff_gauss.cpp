@@ -0,0 +1,384 @@
+#include "vec_diff_gauss.hpp"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <utility>
+#include <immintrin.h>
+
+// Reuse kernel generator and scalar fallbacks
+extern std::vector<float> create1dGaussianKernel(float sigma);
+extern void convolve_x(ConstImageView input, ImageView output, const std::vector<float>& kernel);
+extern void convolve_y(ConstImageView input, ImageView output, const std::vector<float>& kernel,
+                       std::vector<const float*>& rows);
+
+// Every ISA-specific function below carries its own target attribute, so this
+// file compiles (and the binary runs) without -march=native. The dispatcher
+// only calls a variant after cpuid confirmed the CPU supports it.
+#define VEC_TARGET_SSE42  __attribute__((target("sse4.2")))
+#define VEC_TARGET_AVX2   __attribute__((target("avx2,fma")))
+#define VEC_TARGET_AVX512 __attribute__((target("avx512f")))
+
+VecISA detectVecISA() {
+    // __builtin_cpu_supports reads cpuid (and checks OS support for the
+    // wider register state), cached by the runtime after the first call.
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return VecISA::AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return VecISA::AVX2;
+    if (__builtin_cpu_supports("sse4.2")) return VecISA::SSE42;
+    return VecISA::Scalar;
+}
+
+const char* vecISAName(VecISA isa) {
+    switch (isa) {
+        case VecISA::AVX512: return "AVX-512";
+        case VecISA::AVX2:   return "AVX2+FMA";
+        case VecISA::SSE42:  return "SSE4.2";
+        default:             return "Scalar";
+    }
+}
+
+// --- Scalar helpers shared by all ISAs ---
+
+// One output pixel of the horizontal pass with clamped borders
+static inline float convolvePixelClamped(const float* row, int w, int x, const float* kernel, int kSize, int radius) {
+    float sum = 0.0f;
+    for (int k = 0; k < kSize; ++k) {
+        int nx = std::clamp(x + k - radius, 0, w - 1);
+        sum += row[nx] * kernel[k];
+    }
+    return sum;
+}
+
+// One output pixel of the horizontal pass, caller guarantees no clamping is needed
+static inline float convolvePixel(const float* row, int x, const float* kernel, int kSize, int radius) {
+    const float* src = row + x - radius;
+    float sum = 0.0f;
+    for (int k = 0; k < kSize; ++k) {
+        sum += src[k] * kernel[k];
+    }
+    return sum;
+}
+
+// One output pixel of the vertical pass, rows[k] is the (clamped) source row for tap k
+static inline float convolveColumn(const float* const* rows, int x, const float* kernel, int kSize) {
+    float sum = 0.0f;
+    for (int k = 0; k < kSize; ++k) {
+        sum += rows[k][x] * kernel[k];
+    }
+    return sum;
+}
+
+// --- SSE4.2: 4 outputs per vector (no FMA) ---
+
+VEC_TARGET_SSE42
+static void convolve_x_row_SSE42(const float* row, float* out, int w, const float* kernel, int kSize) {
+    int radius = kSize / 2;
+    int begin = std::min(radius, w);
+    int end = std::max(begin, w - radius);
+
+    for (int x = 0; x < begin; ++x) out[x] = convolvePixelClamped(row, w, x, kernel, kSize, radius);
+
+    int x = begin;
+    for (; x + 8 <= end; x += 8) {
+        __m128 acc0 = _mm_setzero_ps();
+        __m128 acc1 = _mm_setzero_ps();
+        const float* src = row + x - radius;
+        for (int k = 0; k < kSize; ++k) {
+            __m128 wk = _mm_set1_ps(kernel[k]);
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(src + k), wk));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(src + k + 4), wk));
+        }
+        _mm_storeu_ps(out + x, acc0);
+        _mm_storeu_ps(out + x + 4, acc1);
+    }
+    for (; x < end; ++x) out[x] = convolvePixel(row, x, kernel, kSize, radius);
+
+    for (x = end; x < w; ++x) out[x] = convolvePixelClamped(row, w, x, kernel, kSize, radius);
+}
+
+VEC_TARGET_SSE42
+static void convolve_y_row_SSE42(const float* const* rows, float* out, int w, const float* kernel, int kSize) {
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        __m128 acc0 = _mm_setzero_ps();
+        __m128 acc1 = _mm_setzero_ps();
+        __m128 acc2 = _mm_setzero_ps();
+        __m128 acc3 = _mm_setzero_ps();
+        for (int k = 0; k < kSize; ++k) {
+            const float* src = rows[k] + x;
+            __m128 wk = _mm_set1_ps(kernel[k]);
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(src), wk));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(src + 4), wk));
+            acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(src + 8), wk));
+            acc3 = _mm_add_ps(acc3, _mm_mul_ps(_mm_loadu_ps(src + 12), wk));
+        }
+        _mm_storeu_ps(out + x, acc0);
+        _mm_storeu_ps(out + x + 4, acc1);
+        _mm_storeu_ps(out + x + 8, acc2);
+        _mm_storeu_ps(out + x + 12, acc3);
+    }
+    for (; x + 4 <= w; x += 4) {
+        __m128 acc = _mm_setzero_ps();
+        for (int k = 0; k < kSize; ++k) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(rows[k] + x), _mm_set1_ps(kernel[k])));
+        }
+        _mm_storeu_ps(out + x, acc);
+    }
+    for (; x < w; ++x) out[x] = convolveColumn(rows, x, kernel, kSize);
+}
+
+// --- AVX2 + FMA: 8 outputs per vector ---
+
+VEC_TARGET_AVX2
+static void convolve_x_row_AVX2(const float* row, float* out, int w, const float* kernel, int kSize) {
+    int radius = kSize / 2;
+    int begin = std::min(radius, w);
+    int end = std::max(begin, w - radius);
+
+    for (int x = 0; x < begin; ++x) out[x] = convolvePixelClamped(row, w, x, kernel, kSize, radius);
+
+    int x = begin;
+    for (; x + 16 <= end; x += 16) {
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        const float* src = row + x - radius;
+        for (int k = 0; k < kSize; ++k) {
+            __m256 wk = _mm256_set1_ps(kernel[k]);
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(src + k), wk, acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(src + k + 8), wk, acc1);
+        }
+        _mm256_storeu_ps(out + x, acc0);
+        _mm256_storeu_ps(out + x + 8, acc1);
+    }
+    for (; x < end; ++x) out[x] = convolvePixel(row, x, kernel, kSize, radius);
+
+    for (x = end; x < w; ++x) out[x] = convolvePixelClamped(row, w, x, kernel, kSize, radius);
+}
+
+VEC_TARGET_AVX2
+static void convolve_y_row_AVX2(const float* const* rows, float* out, int w, const float* kernel, int kSize) {
+    int x = 0;
+    for (; x + 32 <= w; x += 32) {
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        __m256 acc2 = _mm256_setzero_ps();
+        __m256 acc3 = _mm256_setzero_ps();
+        for (int k = 0; k < kSize; ++k) {
+            const float* src = rows[k] + x;
+            __m256 wk = _mm256_set1_ps(kernel[k]);
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(src), wk, acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(src + 8), wk, acc1);
+            acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(src + 16), wk, acc2);
+            acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(src + 24), wk, acc3);
+        }
+        _mm256_storeu_ps(out + x, acc0);
+        _mm256_storeu_ps(out + x + 8, acc1);
+        _mm256_storeu_ps(out + x + 16, acc2);
+        _mm256_storeu_ps(out + x + 24, acc3);
+    }
+    for (; x + 8 <= w; x += 8) {
+        __m256 acc = _mm256_setzero_ps();
+        for (int k = 0; k < kSize; ++k) {
+            acc = _mm256_fmadd_ps(_mm256_loadu_ps(rows[k] + x), _mm256_set1_ps(kernel[k]), acc);
+        }
+        _mm256_storeu_ps(out + x, acc);
+    }
+    for (; x < w; ++x) out[x] = convolveColumn(rows, x, kernel, kSize);
+}
+
+// --- AVX-512: 16 outputs per vector ---
+
+VEC_TARGET_AVX512
+static void convolve_x_row_AVX512(const float* row, float* out, int w, const float* kernel, int kSize) {
+    int radius = kSize / 2;
+    int begin = std::min(radius, w);
+    int end = std::max(begin, w - radius);
+
+    for (int x = 0; x < begin; ++x) out[x] = convolvePixelClamped(row, w, x, kernel, kSize, radius);
+
+    int x = begin;
+    for (; x + 32 <= end; x += 32) {
+        __m512 acc0 = _mm512_setzero_ps();
+        __m512 acc1 = _mm512_setzero_ps();
+        const float* src = row + x - radius;
+        for (int k = 0; k < kSize; ++k) {
+            __m512 wk = _mm512_set1_ps(kernel[k]);
+            acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(src + k), wk, acc0);
+            acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(src + k + 16), wk, acc1);
+        }
+        _mm512_storeu_ps(out + x, acc0);
+        _mm512_storeu_ps(out + x + 16, acc1);
+    }
+    for (; x < end; ++x) out[x] = convolvePixel(row, x, kernel, kSize, radius);
+
+    for (x = end; x < w; ++x) out[x] = convolvePixelClamped(row, w, x, kernel, kSize, radius);
+}
+
+VEC_TARGET_AVX512
+static void convolve_y_row_AVX512(const float* const* rows, float* out, int w, const float* kernel, int kSize) {
+    int x = 0;
+    for (; x + 64 <= w; x += 64) {
+        __m512 acc0 = _mm512_setzero_ps();
+        __m512 acc1 = _mm512_setzero_ps();
+        __m512 acc2 = _mm512_setzero_ps();
+        __m512 acc3 = _mm512_setzero_ps();
+        for (int k = 0; k < kSize; ++k) {
+            const float* src = rows[k] + x;
+            __m512 wk = _mm512_set1_ps(kernel[k]);
+            acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(src), wk, acc0);
+            acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(src + 16), wk, acc1);
+            acc2 = _mm512_fmadd_ps(_mm512_loadu_ps(src + 32), wk, acc2);
+            acc3 = _mm512_fmadd_ps(_mm512_loadu_ps(src + 48), wk, acc3);
+        }
+        _mm512_storeu_ps(out + x, acc0);
+        _mm512_storeu_ps(out + x + 16, acc1);
+        _mm512_storeu_ps(out + x + 32, acc2);
+        _mm512_storeu_ps(out + x + 48, acc3);
+    }
+    for (; x + 16 <= w; x += 16) {
+        __m512 acc = _mm512_setzero_ps();
+        for (int k = 0; k < kSize; ++k) {
+            acc = _mm512_fmadd_ps(_mm512_loadu_ps(rows[k] + x), _mm512_set1_ps(kernel[k]), acc);
+        }
+        _mm512_storeu_ps(out + x, acc);
+    }
+    for (; x < w; ++x) out[x] = convolveColumn(rows, x, kernel, kSize);
+}
+
+// --- Runtime dispatch ---
+
+typedef void (*ConvolveRowFn)(const float* row, float* out, int w, const float* kernel, int kSize);
+typedef void (*ConvolveColumnsFn)(const float* const* rows, float* out, int w, const float* kernel, int kSize);
+
+static VecISA activeISA() {
+    static const VecISA isa = detectVecISA();
+    return isa;
+}
+
+static ConvolveRowFn selectRowKernel(VecISA isa) {
+    switch (isa) {
+        case VecISA::AVX512: return convolve_x_row_AVX512;
+        case VecISA::AVX2:   return convolve_x_row_AVX2;
+        case VecISA::SSE42:  return convolve_x_row_SSE42;
+        default:             return nullptr;
+    }
+}
+
+static ConvolveColumnsFn selectColumnKernel(VecISA isa) {
+    switch (isa) {
+        case VecISA::AVX512: return convolve_y_row_AVX512;
+        case VecISA::AVX2:   return convolve_y_row_AVX2;
+        case VecISA::SSE42:  return convolve_y_row_SSE42;
+        default:             return nullptr;
+    }
+}
+
+void convolve_x_VEC(ConstImageView input, ImageView output, const std::vector<float>& kernel) {
+    ConvolveRowFn rowKernel = selectRowKernel(activeISA());
+    if (rowKernel == nullptr) {
+        convolve_x(input, output, kernel);
+        return;
+    }
+
+    int w = input.width;
+    int h = input.height;
+    int kSize = kernel.size();
+
+    for (int y = 0; y < h; ++y) {
+        rowKernel(input.row(y), output.row(y), w, kernel.data(), kSize);
+    }
+}
+
+// 'rows' is caller-owned scratch for the per-tap row pointers
+static void convolve_y_VEC(ConstImageView input, ImageView output, const std::vector<float>& kernel,
+                           std::vector<const float*>& rows) {
+    ConvolveColumnsFn columnKernel = selectColumnKernel(activeISA());
+    if (columnKernel == nullptr) {
+        convolve_y(input, output, kernel, rows);
+        return;
+    }
+
+    int w = input.width;
+    int h = input.height;
+    int kSize = kernel.size();
+    int radius = kSize / 2;
+
+    // Source rows for each tap, clamped at the top/bottom border.
+    // Every output row is written exactly once, no zero-fill needed.
+    if (rows.size() < static_cast<size_t>(kSize)) rows.resize(kSize);
+    for (int y = 0; y < h; ++y) {
+        for (int k = 0; k < kSize; ++k) {
+            int ny = std::clamp(y + k - radius, 0, h - 1);
+            rows[k] = input.row(ny);
+        }
+        columnKernel(rows.data(), output.row(y), w, kernel.data(), kSize);
+    }
+}
+
+void convolve_y_VEC(ConstImageView input, ImageView output, const std::vector<float>& kernel) {
+    std::vector<const float*> rows;
+    convolve_y_VEC(input, output, kernel, rows);
+}
+
+// Direct blur with the kernel cached in, and row scratch taken from, 'workspace'.
+// If 'input' already carries a blur of inputSigma, only the residual is applied.
+static void GaussianBlurRaw_VEC(ConstImageView input, Image& output, Image& tempBuffer, float sigma,
+                                float inputSigma, XDoGWorkspace& workspace) {
+    tempBuffer.resize(input.width, input.height);
+    output.resize(input.width, input.height);
+
+    if (inputSigma > 0.0f) sigma = cascadeSigma(sigma, inputSigma);
+    const std::vector<float>& kernel = workspace.kernel(sigma);
+    convolve_x_VEC(input, tempBuffer, kernel);
+    convolve_y_VEC(tempBuffer, output, kernel, workspace.rowPointers(0));
+}
+
+void applyXDoG_VEC(ConstImageView input, Image& output, float sigma, float k, float p, float epsilon, float phi,
+                   const XDoGOptions& options, XDoGWorkspace& workspace) {
+    // Sized before the blurs, so scratch use of temp1 never reallocates it
+    output.resize(input.width, input.height);
+    applyXDoG_VEC(input, ImageView(output), sigma, k, p, epsilon, phi, options, workspace);
+}
+
+void applyXDoG_VEC(ConstImageView input, ImageView output, float sigma, float k, float p, float epsilon, float phi,
+                   const XDoGOptions& options, XDoGWorkspace& workspace) {
+    Image& g1 = workspace.g1;
+    Image& g2 = workspace.g2;
+    Image& temp = workspace.temp2;
+    g1.resize(input.width, input.height);
+    g2.resize(input.width, input.height);
+
+    // Box and recursive blurs are already SIMD across rows/columns
+    if (options.blurMode == BlurMode::Box) {
+        GaussianBlurBox(input, g1, temp, sigma, options.boxPasses, workspace);
+        GaussianBlurBox(input, g2, temp, sigma * k, options.boxPasses, workspace);
+    } else {
+        XDoGOptions pair = resolveBlurPair(options, sigma, k);
+        if (useRecursiveBlur(pair, sigma)) {
+            GaussianBlurIIR(input, g1, temp, sigma, workspace);
+        } else {
+            GaussianBlurRaw_VEC(input, g1, temp, sigma, 0.0f, workspace);
+        }
+        if (options.blurMode == BlurMode::Cascaded && k > 1.0f) {
+            GaussianBlurRaw_VEC(g1, g2, temp, sigma * k, sigma, workspace);
+            fixCascadeBorder(input, g2, temp, sigma * k, sigma, workspace);
+        } else if (useRecursiveBlur(pair, sigma * k)) {
+            GaussianBlurIIR(input, g2, temp, sigma * k, workspace);
+        } else {
+            GaussianBlurRaw_VEC(input, g2, temp, sigma * k, 0.0f, workspace);
+        }
+    }
+
+    int w = input.width;
+    for (int y = 0; y < input.height; ++y) {
+        xdog_row(g1.row(y), g2.row(y), output.row(y), w, p, epsilon, phi, options.tanhMode);
+    }
+}
+
+Image applyXDoG_VEC(ConstImageView input, float sigma, float k, float p, float epsilon, float phi,
+                    const XDoGOptions& options) {
+    XDoGWorkspace workspace;
+    applyXDoG_VEC(input, workspace.temp1, sigma, k, p, epsilon, phi, options, workspace);
+    return std::move(workspace.temp1);
+}
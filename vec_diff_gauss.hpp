@@ -0,0 +1,34 @@
+#ifndef VEC_DIFF_GAUSS_H
+#define VEC_DIFF_GAUSS_H
+
+#include "seq_diff_gauss.hpp" // Include this to get the 'Image' struct definition
+#include "file_manager.h"
+#include <vector>
+
+// Instruction sets the hand-written vector backend can dispatch to.
+// The best one supported by the running CPU is picked once via cpuid,
+// so a single binary reaches full vector width on every node.
+enum class VecISA {
+    Scalar,  // No usable SIMD extension: falls back to the sequential kernels
+    SSE42,   // 4 floats per vector
+    AVX2,    // 8 floats per vector (+FMA)
+    AVX512   // 16 floats per vector
+};
+
+VecISA detectVecISA();
+const char* vecISAName(VecISA isa);
+
+// Function declarations with _VEC suffix to avoid linker collisions
+void convolve_x_VEC(ConstImageView input, ImageView output, const std::vector<float>& kernel);
+void convolve_y_VEC(ConstImageView input, ImageView output, const std::vector<float>& kernel);
+
+Image applyXDoG_VEC(ConstImageView input, float sigma, float k, float p, float epsilon, float phi,
+                    const XDoGOptions& options = XDoGOptions());
+
+// Allocation-free form for repeated calls; 'output' may be workspace.temp1
+void applyXDoG_VEC(ConstImageView input, Image& output, float sigma, float k, float p, float epsilon, float phi,
+                   const XDoGOptions& options, XDoGWorkspace& workspace);
+void applyXDoG_VEC(ConstImageView input, ImageView output, float sigma, float k, float p, float epsilon, float phi,
+                   const XDoGOptions& options, XDoGWorkspace& workspace);
+
+#endif